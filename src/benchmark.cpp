@@ -0,0 +1,108 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+
+std::optional<BenchmarkResults> ParseBenchmarkResults(const Path& results_file_path) {
+  std::ifstream results_file(results_file_path);
+  if (!results_file.is_open()) {
+    return std::nullopt;
+  }
+
+  const auto results_json = nlohmann::json::parse(results_file, nullptr, false);
+  if (results_json.is_discarded() || !results_json.contains("benchmarks")) {
+    spdlog::error("Failed to parse benchmark results {}", results_file_path.string());
+    return std::nullopt;
+  }
+
+  BenchmarkResults results;
+  for (const auto& benchmark : results_json["benchmarks"]) {
+    // Aggregates (mean, median, ...) are computed from the repetitions again.
+    if (benchmark.value("run_type", "iteration") != "iteration") {
+      continue;
+    }
+    const std::string name = benchmark.contains("run_name") ? benchmark["run_name"] : benchmark["name"];
+    results[name].push_back(benchmark.at("real_time"));
+  }
+
+  return results;
+}
+
+std::vector<BenchmarkComparison> CompareBenchmarks(const BenchmarkResults& baseline, const BenchmarkResults& contender) {
+  const auto mean = [](const std::vector<double>& values) {
+    return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+  };
+
+  std::vector<BenchmarkComparison> comparisons;
+  for (const auto& [name, contender_times] : contender) {
+    const auto baseline_times = baseline.find(name);
+    if (baseline_times == baseline.end() || baseline_times->second.empty() || contender_times.empty()) {
+      continue;
+    }
+
+    const auto baseline_mean = mean(baseline_times->second);
+    const auto contender_mean = mean(contender_times);
+    comparisons.push_back({
+      .name = name,
+      .baseline_mean = baseline_mean,
+      .contender_mean = contender_mean,
+      .change = baseline_mean > 0 ? (contender_mean - baseline_mean) / baseline_mean : 0.0,
+      .p_value = MannWhitneyUTest(baseline_times->second, contender_times),
+    });
+  }
+
+  return comparisons;
+}
+
+double MannWhitneyUTest(const std::vector<double>& lhs, const std::vector<double>& rhs) {
+  struct Sample {
+    double value;
+    bool is_lhs;
+  };
+  std::vector<Sample> samples;
+  for (const auto value : lhs) {
+    samples.push_back({ value, true });
+  }
+  for (const auto value : rhs) {
+    samples.push_back({ value, false });
+  }
+  std::sort(samples.begin(), samples.end(), [](const auto& a, const auto& b) { return a.value < b.value; });
+
+  // Assign average ranks to ties and accumulate the tie correction term.
+  double lhs_rank_sum = 0.0;
+  double tie_correction = 0.0;
+  for (size_t begin = 0; begin < samples.size();) {
+    size_t end = begin + 1;
+    while (end < samples.size() && samples[end].value == samples[begin].value) {
+      ++end;
+    }
+    const double rank = (begin + end + 1) / 2.0;
+    for (size_t i = begin; i < end; ++i) {
+      if (samples[i].is_lhs) {
+        lhs_rank_sum += rank;
+      }
+    }
+    const double tie_count = end - begin;
+    tie_correction += tie_count * tie_count * tie_count - tie_count;
+    begin = end;
+  }
+
+  const double n1 = lhs.size();
+  const double n2 = rhs.size();
+  const double n = n1 + n2;
+  const double u = lhs_rank_sum - n1 * (n1 + 1) / 2.0;
+  const double mean_u = n1 * n2 / 2.0;
+  const double variance_u = n1 * n2 / 12.0 * ((n + 1) - tie_correction / (n * (n - 1)));
+  if (variance_u <= 0.0) {
+    return 1.0;
+  }
+
+  // Continuity corrected z-score.
+  const double z = (std::abs(u - mean_u) - 0.5) / std::sqrt(variance_u);
+  return std::min(1.0, std::erfc(std::max(z, 0.0) / std::sqrt(2.0)));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+// Maps the name of each benchmark to the real time of its repetitions.
+using BenchmarkResults = std::map<std::string, std::vector<double>>;
+
+struct BenchmarkComparison {
+  std::string name;
+  double baseline_mean;
+  double contender_mean;
+  // Relative change of the mean time, e.g. 0.1 if the contender is 10% slower.
+  double change;
+  // Two-sided p-value of the Mann-Whitney U test.
+  double p_value;
+};
+
+// Reads the results of a benchmark executable run with --benchmark_out_format=json.
+std::optional<BenchmarkResults> ParseBenchmarkResults(const Path& results_file_path);
+
+// Compares all benchmarks that are part of both results.
+std::vector<BenchmarkComparison> CompareBenchmarks(const BenchmarkResults& baseline, const BenchmarkResults& contender);
+
+// Returns the two-sided p-value for the hypothesis that both samples come from
+// the same distribution using the normal approximation of the U statistic.
+double MannWhitneyUTest(const std::vector<double>& lhs, const std::vector<double>& rhs);
@@ -0,0 +1,470 @@
+#include "binary_cache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <regex>
+#include <set>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "cmake.hpp"
+#include "context.hpp"
+#include "nlohmann/json.hpp"
+#include "repository.hpp"
+#include "spdlog/fmt/bundled/format.h"
+#include "spdlog/spdlog.h"
+#include "subprocess.hpp"
+
+namespace {
+
+// Cache variables of the project that are passed on to the packages and thus
+// affect the binaries.
+const std::vector<std::string> kRelevantCacheVariables = {
+  "CMAKE_BUILD_TYPE",
+  "CMAKE_C_COMPILER",
+  "CMAKE_CXX_COMPILER",
+  "CMAKE_C_FLAGS",
+  "CMAKE_CXX_FLAGS",
+  "CMAKE_CXX_STANDARD",
+  "CMAKE_POSITION_INDEPENDENT_CODE",
+  "CMAKE_OSX_ARCHITECTURES",
+  "BUILD_SHARED_LIBS",
+};
+
+// Marks cache entries of packages that failed to build.
+const char* const kFailedBuildMarker = "cpm-build-failed";
+
+// Holds an exclusive lock on a file in the binary cache, other processes
+// sharing the cache block until it is released.
+struct FileLock {
+  int fd;
+
+  explicit FileLock(const Path& path) : fd(open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) {
+    while (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+      if (errno != EINTR) {
+        spdlog::warn("Failed to lock {}: {}", path.string(), std::strerror(errno));
+        break;
+      }
+    }
+  }
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+  ~FileLock() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+Path GetStatisticsFilePath() {
+  return g_context.paths.binary_cache / "statistics.json";
+}
+
+// Files read by concurrent configures are replaced atomically.
+bool ReplaceFile(const Path& path, std::string_view content) {
+  const auto temporary_path = Path(fmt::format("{}.{}", path.string(), getpid()));
+  std::error_code error;
+  if (!WriteFile(temporary_path, content) || (fs::rename(temporary_path, path, error), error)) {
+    fs::remove(temporary_path, error);
+    return false;
+  }
+  return true;
+}
+
+void RecordLookups(unsigned hits, unsigned misses) {
+  FileLock lock(g_context.paths.binary_cache / "statistics.lock");
+
+  nlohmann::json statistics = { { "hits", 0 }, { "misses", 0 } };
+  if (std::ifstream statistics_file(GetStatisticsFilePath()); statistics_file.is_open()) {
+    if (const auto stored_statistics = nlohmann::json::parse(statistics_file, nullptr, false); stored_statistics.is_object()) {
+      statistics = stored_statistics;
+    }
+  }
+  statistics["hits"] = statistics.value("hits", 0u) + hits;
+  statistics["misses"] = statistics.value("misses", 0u) + misses;
+  ReplaceFile(GetStatisticsFilePath(), statistics.dump(2));
+}
+
+// Returns the tag CPM checks out for the package.
+std::string GetPackageTag(const PackageReference& package) {
+  if (package.tag.length() > 0) {
+    return package.tag;
+  } else {
+    return fmt::format("v{}", package.version);
+  }
+}
+
+Path GetCommitsFilePath() {
+  return g_context.paths.binary_cache / "commits.json";
+}
+
+// Returns the commit the tag of the package points to. Tags are not expected
+// to move, so resolved commits are remembered in the cache to avoid querying
+// the remote on every configure.
+std::optional<std::string> ResolveCommit(const PackageReference& package) {
+  const auto tag = GetPackageTag(package);
+  const auto commit_key = fmt::format("{}#{}", package.repository.url, tag);
+
+  nlohmann::json commits = nlohmann::json::object();
+  if (std::ifstream commits_file(GetCommitsFilePath()); commits_file.is_open()) {
+    if (const auto stored_commits = nlohmann::json::parse(commits_file, nullptr, false); stored_commits.is_object()) {
+      commits = stored_commits;
+    }
+  }
+  if (const auto commit = commits.find(commit_key); commit != commits.end() && commit->is_string()) {
+    return commit->get<std::string>();
+  }
+
+  std::optional<std::string> commit;
+  try {
+    const auto output = subprocess::check_output(
+      { "git", "ls-remote", package.repository.url.c_str(), fmt::format("refs/tags/{}", tag).c_str(), fmt::format("refs/tags/{}^{{}}", tag).c_str() }
+    );
+    const std::string refs(output.buf.data(), output.length);
+
+    // Annotated tags are listed twice, the entry ending with ^{} contains the commit.
+    std::regex ref_definition(R"(([0-9a-f]{40})\s+(\S+))");
+    for (auto match = std::sregex_iterator(refs.begin(), refs.end(), ref_definition); match != std::sregex_iterator(); ++match) {
+      if (!commit || (*match)[2].str().ends_with("^{}")) {
+        commit = (*match)[1].str();
+      }
+    }
+  } catch (const std::exception&) {
+  }
+
+  if (!commit) {
+    // CPM also accepts commit hashes as tags.
+    if (std::regex_match(tag, std::regex("[0-9a-f]{7,40}"))) {
+      return tag;
+    }
+    return std::nullopt;
+  }
+
+  FileLock lock(g_context.paths.binary_cache / "commits.lock");
+  if (std::ifstream commits_file(GetCommitsFilePath()); commits_file.is_open()) {
+    if (const auto stored_commits = nlohmann::json::parse(commits_file, nullptr, false); stored_commits.is_object()) {
+      commits = stored_commits;
+    }
+  }
+  commits[commit_key] = *commit;
+  ReplaceFile(GetCommitsFilePath(), commits.dump(2));
+
+  return commit;
+}
+
+// Returns the name of the CMake config package in the install, preferring the
+// name CPM uses for the package, e.g. nlohmann_json for the package json.
+std::optional<std::string> FindInstalledPackageName(const Path& install_path, const std::string& package_name) {
+  static const std::regex config_file_definition(R"((.+)(Config|-config)\.cmake)");
+
+  std::set<std::string> config_names;
+  for (const auto& entry : fs::recursive_directory_iterator(install_path)) {
+    std::smatch match;
+    const auto filename = entry.path().filename().string();
+    if (entry.is_regular_file() && std::regex_match(filename, match, config_file_definition)) {
+      config_names.insert(match[1].str());
+    }
+  }
+
+  const auto to_lower = [](std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    return name;
+  };
+  for (const auto& config_name : config_names) {
+    if (to_lower(config_name) == to_lower(package_name)) {
+      return config_name;
+    }
+  }
+  if (config_names.size() == 1) {
+    return *config_names.begin();
+  }
+  return std::nullopt;
+}
+
+// Writes the project CPM adds instead of the sources of the package. It makes
+// the imported targets of the installed package visible to the whole project,
+// like the targets of a package added from source.
+bool WriteCachedPackageProject(const Path& project_path, const Path& install_path, const std::string& config_name) {
+  std::error_code error;
+  fs::create_directories(project_path, error);
+  return WriteFile(
+    project_path / "CMakeLists.txt",
+    fmt::format(
+      R"(cmake_minimum_required(VERSION 3.21)
+
+# Generated by cpm-cli, uses the install of the package in the binary cache.
+list(APPEND CMAKE_PREFIX_PATH "{0}")
+find_package({1} REQUIRED CONFIG PATHS "{0}" NO_DEFAULT_PATH)
+
+get_property(imported_targets DIRECTORY PROPERTY IMPORTED_TARGETS)
+foreach(imported_target IN LISTS imported_targets)
+  set_property(TARGET ${{imported_target}} PROPERTY IMPORTED_GLOBAL TRUE)
+endforeach()
+)",
+      install_path.generic_string(),
+      config_name
+    )
+  );
+}
+
+// Builds the package in a directory of its own and publishes the install with
+// an atomic rename, so concurrent configures never see incomplete installs.
+// The caller holds the lock of the cache entry.
+bool BuildPackage(const PackageReference& package, const std::string& commit, const std::vector<std::string>& cmake_arguments, const Path& install_path, const std::string& key_string) {
+  std::random_device random_device;
+  const auto work_path = g_context.paths.binary_cache / "tmp" / fmt::format("{}-{}-{:08x}", install_path.filename().string(), getpid(), random_device());
+  const auto source_path = work_path / "source";
+  const auto build_path = work_path / "build";
+  // The package is installed with DESTDIR so that its files refer to the final install path.
+  const auto staging_path = work_path / "staging";
+  const auto staged_install_path = staging_path / install_path.relative_path();
+
+  bool success =
+    subprocess::Popen({ "git", "clone", "--quiet", "--recursive", package.repository.url.c_str(), source_path.c_str() }).wait() == 0 &&
+    subprocess::Popen({ "git", "checkout", "--quiet", commit.c_str() }, subprocess::cwd{ source_path.c_str() }).wait() == 0 &&
+    subprocess::Popen({ "git", "submodule", "update", "--quiet", "--init", "--recursive" }, subprocess::cwd{ source_path.c_str() }).wait() == 0;
+
+  if (success) {
+    auto arguments = cmake_arguments;
+    arguments.push_back(fmt::format("-DCMAKE_INSTALL_PREFIX={}", install_path.string()));
+    arguments.push_back("-DBUILD_TESTING=OFF");
+    success =
+      Configure(source_path, build_path, arguments) &&
+      BuildTargets(build_path, {}, { "--parallel" }) &&
+      subprocess::Popen(
+        { "cmake", "--install", build_path.c_str() },
+        subprocess::environment{ { { "DESTDIR", staging_path.string() } } }
+      ).wait() == 0;
+  }
+
+  if (success) {
+    // Installs without a config package are cached as well so that they are
+    // not built again on every configure, but they are never used.
+    if (const auto config_name = FindInstalledPackageName(staged_install_path, package.repository.name); config_name) {
+      success = WriteCachedPackageProject(staged_install_path / "cpm-package", install_path, *config_name);
+    } else {
+      spdlog::warn("{} does not install a CMake config package, it is built from source", package.repository.name);
+    }
+  }
+
+  std::error_code error;
+  if (success && WriteFile(staged_install_path / "cpm-cache-key.json", key_string)) {
+    // Anything at the install path has a different key (e.g. a hash collision).
+    fs::remove_all(install_path, error);
+    fs::rename(staged_install_path, install_path, error);
+    if (error) {
+      spdlog::error("Failed to move {} to {}: {}", staged_install_path.string(), install_path.string(), error.message());
+      success = false;
+    }
+  } else {
+    success = false;
+  }
+
+  fs::remove_all(work_path, error);
+  return success;
+}
+
+// Publishes an entry without an install for a package that failed to build,
+// so that it is built from source instead of being built again on every
+// configure. The caller holds the lock of the cache entry.
+void PublishFailedBuild(const Path& install_path, const std::string& key_string) {
+  std::random_device random_device;
+  const auto work_path = g_context.paths.binary_cache / "tmp" / fmt::format("{}-{}-{:08x}", install_path.filename().string(), getpid(), random_device());
+
+  std::error_code error;
+  if (fs::create_directories(work_path, error) &&
+      WriteFile(work_path / kFailedBuildMarker, "") &&
+      WriteFile(work_path / "cpm-cache-key.json", key_string)) {
+    fs::remove_all(install_path, error);
+    fs::rename(work_path, install_path, error);
+  }
+  if (error) {
+    spdlog::warn("Failed to record the failed build in {}: {}", install_path.string(), error.message());
+  }
+  fs::remove_all(work_path, error);
+}
+
+std::uintmax_t GetDirectorySize(const Path& path) {
+  std::uintmax_t size = 0;
+  for (const auto& entry : fs::recursive_directory_iterator(path)) {
+    if (entry.is_regular_file() && !entry.is_symlink()) {
+      size += entry.file_size();
+    }
+  }
+  return size;
+}
+
+std::vector<std::string> GetCachedPackageArguments(const Project& project, const Path& build_path, std::map<std::string, std::string> cache_variables, const std::vector<std::string>& cmake_arguments) {
+  if (!g_context.config["binary_cache"]["enabled"].value_or(true)) {
+    return {};
+  }
+
+  const auto compiler = GetCompilerInfo(build_path);
+  if (!compiler) {
+    spdlog::warn("Failed to determine the compiler, packages are built from source");
+    return {};
+  }
+
+  // Variables passed to this configure take precedence over the ones of the previous one.
+  static const std::regex variable_definition(R"(-D([^:=]+)(:[^=]*)?=(.*))");
+  for (const auto& argument : cmake_arguments) {
+    if (std::smatch match; std::regex_match(argument, match, variable_definition)) {
+      cache_variables[match[1].str()] = match[3].str();
+    }
+  }
+
+  nlohmann::json build_configuration = {
+    { "compiler", compiler->id },
+    { "compiler_version", compiler->version },
+  };
+  std::vector<std::string> package_cmake_arguments;
+  for (const auto& variable : kRelevantCacheVariables) {
+    if (const auto value = cache_variables.find(variable); value != cache_variables.end() && value->second.length() > 0) {
+      build_configuration["variables"][variable] = value->second;
+      package_cmake_arguments.push_back(fmt::format("-D{}={}", variable, value->second));
+    }
+  }
+
+  if (!fs::exists(g_context.paths.binary_cache) && !fs::create_directories(g_context.paths.binary_cache)) {
+    spdlog::error("Failed to create directory {}", g_context.paths.binary_cache.string());
+    return {};
+  }
+
+  unsigned hits = 0;
+  unsigned misses = 0;
+  std::vector<std::string> arguments;
+  for (const auto& package_definition : project.GetPackages()) {
+    const auto package = PackageReference::Parse(package_definition);
+    if (!package) {
+      continue;
+    }
+
+    const auto commit = ResolveCommit(*package);
+    if (!commit) {
+      spdlog::warn("Failed to resolve the commit of {}, it is built from source", package_definition);
+      continue;
+    }
+
+    auto key = build_configuration;
+    key["repository"] = package->repository.url;
+    key["commit"] = *commit;
+    const auto key_string = key.dump();
+    const auto entry_name = fmt::format("{}-{:016x}", package->repository.name, HashContent(key_string));
+    const auto install_path = g_context.paths.binary_cache / entry_name;
+    const auto key_file_path = install_path / "cpm-cache-key.json";
+
+    // The key is stored alongside the install to rule out hash collisions.
+    // Installs are published atomically, so the key only exists for complete ones.
+    const auto is_cached = [&]() {
+      const auto stored_key = ReadFile(key_file_path);
+      return stored_key && *stored_key == key_string;
+    };
+    if (is_cached()) {
+      // Failed builds are not retried until the cache is cleared.
+      if (fs::exists(install_path / kFailedBuildMarker)) {
+        continue;
+      }
+      ++hits;
+    } else {
+      // Another configure may build the same package, the lock makes it wait
+      // for the install instead of building it again.
+      FileLock lock(g_context.paths.binary_cache / fmt::format("{}.lock", entry_name));
+      if (is_cached()) {
+        if (fs::exists(install_path / kFailedBuildMarker)) {
+          continue;
+        }
+        ++hits;
+      } else {
+        ++misses;
+        spdlog::info("Building {} for the binary cache", package_definition);
+        if (!BuildPackage(*package, *commit, package_cmake_arguments, install_path, key_string)) {
+          spdlog::warn("Failed to build {} for the binary cache, it is built from source", package_definition);
+          PublishFailedBuild(install_path, key_string);
+          continue;
+        }
+      }
+    }
+
+
+    // CPM adds the project of the cached install instead of the sources of
+    // the package, all other packages are added as usual.
+    if (const auto package_project_path = install_path / "cpm-package"; fs::exists(package_project_path)) {
+      arguments.push_back(fmt::format("-DCPM_{}_SOURCE={}", package->repository.name, package_project_path.string()));
+    }
+  }
+  RecordLookups(hits, misses);
+
+  return arguments;
+}
+
+}
+
+std::vector<std::string> GetBinaryCacheArguments(const Project& project, const Path& build_path, const std::vector<std::string>& cmake_arguments) {
+  const auto cache_variables = ReadCMakeCache(build_path);
+  auto arguments = GetCachedPackageArguments(project, build_path, cache_variables, cmake_arguments);
+
+  // Overrides of previous configures are kept in the CMake cache, the ones
+  // for packages that are no longer taken from the binary cache are removed.
+  static const std::regex override_definition("CPM_.+_SOURCE");
+  const auto binary_cache_path = g_context.paths.binary_cache.string();
+  for (const auto& [variable, value] : cache_variables) {
+    if (!std::regex_match(variable, override_definition) || !value.starts_with(binary_cache_path)) {
+      continue;
+    }
+    const auto override_prefix = fmt::format("-D{}=", variable);
+    if (std::none_of(arguments.begin(), arguments.end(), [&](const auto& argument) { return argument.starts_with(override_prefix); })) {
+      arguments.push_back(fmt::format("-U{}", variable));
+    }
+  }
+
+  return arguments;
+}
+
+BinaryCacheStatistics GetBinaryCacheStatistics() {
+  BinaryCacheStatistics statistics;
+  if (!fs::exists(g_context.paths.binary_cache)) {
+    return statistics;
+  }
+
+  if (std::ifstream statistics_file(GetStatisticsFilePath()); statistics_file.is_open()) {
+    const auto stored_statistics = nlohmann::json::parse(statistics_file, nullptr, false);
+    if (stored_statistics.is_object()) {
+      statistics.hits = stored_statistics.value("hits", 0u);
+      statistics.misses = stored_statistics.value("misses", 0u);
+    }
+  }
+
+  for (const auto& entry : fs::directory_iterator(g_context.paths.binary_cache)) {
+    if (!fs::exists(entry.path() / "cpm-cache-key.json")) {
+      continue;
+    }
+    if (fs::exists(entry.path() / kFailedBuildMarker)) {
+      ++statistics.failed_entries;
+    } else {
+      ++statistics.entries;
+    }
+  }
+  statistics.size = GetDirectorySize(g_context.paths.binary_cache);
+
+  return statistics;
+}
+
+bool ClearBinaryCache() {
+  std::error_code error;
+  fs::remove_all(g_context.paths.binary_cache, error);
+  if (error) {
+    spdlog::error("Failed to remove {}: {}", g_context.paths.binary_cache.string(), error.message());
+    return false;
+  }
+  return true;
+}
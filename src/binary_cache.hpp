@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "project.hpp"
+
+// The binary cache stores installs of the packages of a project. Each package
+// is built in an isolated tree and installed into a directory in
+// g_context.paths.binary_cache whose name is derived from the commit of the
+// package, the compiler, the build type and the relevant flags.
+
+struct BinaryCacheStatistics {
+  unsigned hits = 0;
+  unsigned misses = 0;
+  size_t entries = 0;
+  size_t failed_entries = 0;
+  std::uintmax_t size = 0;
+};
+
+// Installs all missing packages of the configured project into the binary
+// cache and returns the CMake arguments which make CPM use the cached installs.
+// cmake_arguments are the arguments of the upcoming configure, they override
+// the variables of the previous one.
+std::vector<std::string> GetBinaryCacheArguments(const Project& project, const Path& build_path, const std::vector<std::string>& cmake_arguments);
+
+BinaryCacheStatistics GetBinaryCacheStatistics();
+
+bool ClearBinaryCache();
@@ -1,4 +1,12 @@
 #include "cmake.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+#include "nlohmann/json.hpp"
 #include "spdlog/spdlog.h"
 #include "subprocess.hpp"
 
@@ -17,3 +25,222 @@ bool FindCMake() {
     return false;
   }
 }
+
+bool EnsureConfigured(const Path& project_path, const Path& build_path, const std::vector<std::string>& cmake_arguments) {
+  if (fs::exists(build_path / "CMakeCache.txt")) {
+    return true;
+  }
+
+  spdlog::info("Project has not been configured yet");
+  return Configure(project_path, build_path, cmake_arguments);
+}
+
+bool Configure(const Path& project_path, const Path& build_path, const std::vector<std::string>& cmake_arguments) {
+  if (!fs::exists(build_path) && !fs::create_directories(build_path)) {
+    spdlog::error("Failed to create build directory {}", build_path.string());
+    return false;
+  }
+
+  std::vector<std::string> command = { "cmake", "-S", project_path.string(), "-B", build_path.string() };
+  command.insert(command.end(), cmake_arguments.begin(), cmake_arguments.end());
+  if (subprocess::Popen(command).wait() != 0) {
+    spdlog::error("Failed to configure project");
+    return false;
+  }
+
+  return true;
+}
+
+bool BuildTargets(const Path& build_path, const std::vector<std::string>& targets, const std::vector<std::string>& build_arguments) {
+  std::vector<std::string> command = { "cmake", "--build", build_path.string() };
+  for (const auto& target : targets) {
+    command.push_back("--target");
+    command.push_back(target);
+  }
+  command.insert(command.end(), build_arguments.begin(), build_arguments.end());
+  if (subprocess::Popen(command).wait() != 0) {
+    spdlog::error("Failed to build project");
+    return false;
+  }
+
+  return true;
+}
+
+bool RequestCodeModel(const Path& build_path) {
+  const auto query_path = build_path / ".cmake" / "api" / "v1" / "query";
+  if (!fs::exists(query_path) && !fs::create_directories(query_path)) {
+    spdlog::error("Failed to create directory {}", query_path.string());
+    return false;
+  }
+  return fs::exists(query_path / "codemodel-v2") || WriteFile(query_path / "codemodel-v2", "");
+}
+
+bool IsCodeModelOutdated(const Path& build_path, const std::vector<Path>& list_files) {
+  // Every configure writes a new index file into the reply directory.
+  const auto reply_path = build_path / ".cmake" / "api" / "v1" / "reply";
+  std::error_code error;
+  const auto reply_time = fs::last_write_time(reply_path, error);
+  if (error) {
+    return true;
+  }
+  return std::any_of(list_files.begin(), list_files.end(), [&](const Path& list_file) {
+    const auto list_file_time = fs::last_write_time(list_file, error);
+    return error || list_file_time > reply_time;
+  });
+}
+
+std::optional<std::vector<ExecutableTarget>> GetExecutableTargets(const Path& build_path, std::string_view configuration) {
+  const auto reply_path = build_path / ".cmake" / "api" / "v1" / "reply";
+  const auto read_reply = [&](const std::string& filename) {
+    std::ifstream reply_file(reply_path / filename);
+    return nlohmann::json::parse(reply_file);
+  };
+
+  try {
+    // The index file names contain the time they were written, the newest one is the current one.
+    std::optional<std::string> index_filename;
+    if (fs::is_directory(reply_path)) {
+      for (const auto& entry : fs::directory_iterator(reply_path)) {
+        const auto filename = entry.path().filename().string();
+        if (filename.starts_with("index-") && (!index_filename || filename > *index_filename)) {
+          index_filename = filename;
+        }
+      }
+    }
+    if (!index_filename) {
+      return std::nullopt;
+    }
+
+    const auto index = read_reply(*index_filename);
+    if (!index.at("reply").contains("codemodel-v2")) {
+      return std::nullopt;
+    }
+    const auto codemodel = read_reply(index["reply"]["codemodel-v2"].at("jsonFile"));
+
+    // Single-config generators only have the configuration of CMAKE_BUILD_TYPE.
+    const auto& configurations = codemodel.at("configurations");
+    auto selected_configuration = configurations.begin();
+    for (auto configuration_entry = configurations.begin(); configuration_entry != configurations.end(); ++configuration_entry) {
+      if (configuration_entry->at("name") == configuration) {
+        selected_configuration = configuration_entry;
+      }
+    }
+    if (selected_configuration == configurations.end()) {
+      return std::nullopt;
+    }
+
+    std::vector<ExecutableTarget> executable_targets;
+    for (const auto& target_entry : selected_configuration->at("targets")) {
+      const auto target = read_reply(target_entry.at("jsonFile"));
+      if (target.at("type") != "EXECUTABLE" || !target.contains("artifacts")) {
+        continue;
+      }
+      // Artifact paths are relative to the build directory unless they are outside of it.
+      const Path artifact_path = target["artifacts"].at(0).at("path").get<std::string>();
+      ExecutableTarget executable_target = {
+        .name = target.at("name"),
+        .path = artifact_path.is_absolute() ? artifact_path : build_path / artifact_path,
+        .libraries = {},
+      };
+
+      // Target ids have the form <name>::@<directory hash>, aliases such as
+      // benchmark::benchmark are resolved to the target they refer to.
+      for (const auto& dependency : target.value("dependencies", nlohmann::json::array())) {
+        const std::string id = dependency.at("id");
+        executable_target.libraries.push_back(id.substr(0, id.rfind("::@")));
+      }
+      // Imported targets, e.g. of packages found with find_package, only show up on the link line.
+      if (target.contains("link")) {
+        for (const auto& fragment : target["link"].at("commandFragments")) {
+          if (fragment.at("role") == "libraries") {
+            executable_target.libraries.push_back(fragment.at("fragment"));
+          }
+        }
+      }
+
+      executable_targets.push_back(std::move(executable_target));
+    }
+    return executable_targets;
+  } catch (const std::exception& exception) {
+    spdlog::error("Failed to read the targets of {}: {}", build_path.string(), exception.what());
+    return std::nullopt;
+  }
+}
+
+std::optional<CompilerInfo> GetCompilerInfo(const Path& build_path) {
+  const auto cmake_files_path = build_path / "CMakeFiles";
+  if (!fs::is_directory(cmake_files_path)) {
+    return std::nullopt;
+  }
+
+  // CMake stores the detected compiler in CMakeFiles/<cmake version>/CMakeCXXCompiler.cmake.
+  for (const auto& entry : fs::directory_iterator(cmake_files_path)) {
+    const auto compiler_file_content = ReadFile(entry.path() / "CMakeCXXCompiler.cmake");
+    if (!compiler_file_content) {
+      continue;
+    }
+
+    const auto get_variable = [&](const std::string& name) {
+      std::smatch match;
+      std::regex variable_definition("set\\(" + name + " \"([^\"]*)\"\\)");
+      return std::regex_search(*compiler_file_content, match, variable_definition) ? match[1].str() : "";
+    };
+
+    CompilerInfo compiler = {
+      .id = get_variable("CMAKE_CXX_COMPILER_ID"),
+      .version = get_variable("CMAKE_CXX_COMPILER_VERSION"),
+      .path = get_variable("CMAKE_CXX_COMPILER"),
+    };
+
+    std::istringstream include_directories(get_variable("CMAKE_CXX_IMPLICIT_INCLUDE_DIRECTORIES"));
+    std::string include_directory;
+    while (std::getline(include_directories, include_directory, ';')) {
+      if (include_directory.length() > 0) {
+        compiler.implicit_include_directories.push_back(include_directory);
+      }
+    }
+
+    return compiler;
+  }
+
+  return std::nullopt;
+}
+
+std::map<std::string, std::string> ReadCMakeCache(const Path& build_path) {
+  std::map<std::string, std::string> variables;
+
+  const auto cache_content = ReadFile(build_path / "CMakeCache.txt");
+  if (!cache_content) {
+    return variables;
+  }
+
+  // Entries have the form NAME:TYPE=VALUE, comments start with # or //.
+  std::regex entry_definition(R"(^([^#/:][^:]*):[^=]*=(.*)$)");
+  std::istringstream cache_stream(*cache_content);
+  std::string line;
+  std::smatch match;
+  while (std::getline(cache_stream, line)) {
+    if (std::regex_match(line, match, entry_definition)) {
+      variables[match[1].str()] = match[2].str();
+    }
+  }
+
+  return variables;
+}
+
+std::string GetCMakeBuildType(std::string_view build_type) {
+  std::string lowercase_build_type(build_type);
+  std::transform(lowercase_build_type.begin(), lowercase_build_type.end(), lowercase_build_type.begin(), [](unsigned char c) { return std::tolower(c); });
+
+  if (lowercase_build_type == "debug") {
+    return "Debug";
+  } else if (lowercase_build_type == "release") {
+    return "Release";
+  } else if (lowercase_build_type == "relwithdebinfo") {
+    return "RelWithDebInfo";
+  } else if (lowercase_build_type == "minsizerel") {
+    return "MinSizeRel";
+  } else {
+    return std::string(build_type);
+  }
+}
@@ -1,3 +1,60 @@
 #pragma once
 
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
 bool FindCMake();
+
+struct CompilerInfo {
+  // The CMAKE_CXX_COMPILER_ID, e.g. GNU, Clang or AppleClang.
+  std::string id;
+  std::string version;
+  Path path;
+  // Directories the compiler searches for includes by default, e.g. the ones of the standard library.
+  std::vector<Path> implicit_include_directories;
+};
+
+// Returns the C++ compiler used in a configured build directory.
+std::optional<CompilerInfo> GetCompilerInfo(const Path& build_path);
+
+// Returns the variables stored in the CMakeCache.txt of a build directory.
+std::map<std::string, std::string> ReadCMakeCache(const Path& build_path);
+
+// Returns the CMake build type for build types passed on the command line, e.g. Release for release.
+std::string GetCMakeBuildType(std::string_view build_type);
+
+// Configures the project into build_path.
+bool Configure(const Path& project_path, const Path& build_path, const std::vector<std::string>& cmake_arguments = {});
+
+// Configures the project into build_path unless it has been configured before.
+bool EnsureConfigured(const Path& project_path, const Path& build_path, const std::vector<std::string>& cmake_arguments = {});
+
+// Makes CMake describe the targets of the project using its file API the
+// next time build_path is configured.
+bool RequestCodeModel(const Path& build_path);
+
+// Returns whether build_path has no code model or one of the list files
+// changed after it was written.
+bool IsCodeModelOutdated(const Path& build_path, const std::vector<Path>& list_files);
+
+struct ExecutableTarget {
+  std::string name;
+  // The executable the target produces in the configuration, which includes
+  // OUTPUT_NAME and RUNTIME_OUTPUT_DIRECTORY.
+  Path path;
+  // Names of the targets of the project it depends on (e.g. benchmark for
+  // benchmark::benchmark) and the libraries on its link line (e.g.
+  // /usr/lib/libbenchmark.so.1 or -lpthread).
+  std::vector<std::string> libraries;
+};
+
+// Returns the executable targets of the given configuration (e.g. Release).
+// Requires build_path to be configured after calling RequestCodeModel.
+std::optional<std::vector<ExecutableTarget>> GetExecutableTargets(const Path& build_path, std::string_view configuration);
+
+// Builds the given targets or all targets if none are specified.
+bool BuildTargets(const Path& build_path, const std::vector<std::string>& targets = {}, const std::vector<std::string>& build_arguments = {});
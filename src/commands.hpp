@@ -6,3 +6,11 @@ void AddCreateCommand(CLI::App& app);
 void AddAddCommand(CLI::App& app);
 void AddConfigureCommand(CLI::App& app);
 void AddBuildCommand(CLI::App& app);
+void AddDaemonCommand(CLI::App& app);
+void AddTargetsCommand(CLI::App& app);
+void AddOutdatedCommand(CLI::App& app);
+void AddSearchCommand(CLI::App& app);
+void AddTestCommand(CLI::App& app);
+void AddBenchCommand(CLI::App& app);
+void AddCacheCommand(CLI::App& app);
+void AddAnalyzeCommand(CLI::App& app);
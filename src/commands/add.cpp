@@ -1,22 +1,55 @@
 #include "../commands.hpp"
+#include "../daemon.hpp"
 #include "../utils.hpp"
 #include "../project.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/spdlog.h"
 
 void AddAddCommand(CLI::App& app) {
-  const auto add_command = app.add_subcommand("add", "Adds additional packages to the project");
+  const auto add_command = app.add_subcommand("add", "Adds additional packages or targets to the project");
+  const auto add_benchmark_command = add_command->add_subcommand("benchmark", "Adds a benchmark target using Google Benchmark");
 
   static std::string package_definition;
+  static std::string benchmark_name;
 
   add_command
     ->add_option("package_name", package_definition)
-    ->description("The identifier of the package")
+    ->description("The identifier of the package");
+
+  add_benchmark_command
+    ->add_option("benchmark_name", benchmark_name)
+    ->description("The name of the benchmark target")
     ->required();
 
   add_command->callback(
+    [add_command, add_benchmark_command]() {
+      if (add_command->got_subcommand(add_benchmark_command)) {
+        return;
+      }
+      if (package_definition.empty()) {
+        spdlog::error("No package specified");
+        throw CLI::RuntimeError(-1);
+      }
+
+      const auto project = Project::Open(fs::current_path());
+      if (!project) {
+        throw CLI::RuntimeError(-1);
+      }
+
+      const auto answer = Query({ { "query", "resolve" }, { "argument", package_definition } });
+      if (answer.contains("error")) {
+        spdlog::error("{}", answer["error"].get<std::string>());
+        throw CLI::RuntimeError(-1);
+      }
+      project->InsertPackage(answer["result"].get<std::string>());
+    }
+  );
+
+  add_benchmark_command->callback(
     [&]() {
       const auto project = Project::Open(fs::current_path());
-      if (project) {
-        project->AddPackage(package_definition);
+      if (!project || !project->AddBenchmark(benchmark_name)) {
+        throw CLI::RuntimeError(-1);
       }
     }
   );
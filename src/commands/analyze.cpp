@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <thread>
+
+#include "../cmake.hpp"
+#include "../commands.hpp"
+#include "../include_analysis.hpp"
+#include "../utils.hpp"
+#include "../project.hpp"
+#include "CLI/Error.hpp"
+#include "nlohmann/json.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+
+void AddAnalyzeCommand(CLI::App& app) {
+  const auto analyze_command = app.add_subcommand("analyze", "Analyzes the project");
+  analyze_command->require_subcommand(1);
+
+  const auto includes_command = analyze_command->add_subcommand("includes", "Finds the headers that cost the most build time");
+
+  static bool json = false;
+  static size_t top = 20;
+  static unsigned jobs = std::max(std::thread::hardware_concurrency(), 1u);
+
+  includes_command
+    ->add_flag("--json", json)
+    ->description("Print the results as JSON");
+
+  includes_command
+    ->add_option("--top", top)
+    ->description("Number of headers to report, 0 reports all (default: 20)");
+
+  includes_command
+    ->add_option("-j,--jobs", jobs)
+    ->description("Number of threads scanning translation units (default: number of cores)");
+
+  includes_command->callback([&]() {
+    const auto project = Project::Open(fs::current_path());
+    if (!project) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    const auto build_path = project->GetBuildPath();
+    if (!fs::exists(build_path / "compile_commands.json")) {
+      spdlog::info("Project does not export compile commands yet");
+      // Configured without the binary cache, which would build all dependencies.
+      if (!Configure(project->path, build_path, { "-DCMAKE_EXPORT_COMPILE_COMMANDS=ON" })) {
+        throw CLI::RuntimeError(-1);
+      }
+    }
+
+    const auto analysis = AnalyzeIncludes(*project, build_path, jobs);
+    if (!analysis) {
+      throw CLI::RuntimeError(-1);
+    }
+    const auto header_count = top > 0 ? std::min(top, analysis->headers.size()) : analysis->headers.size();
+
+    if (json) {
+      nlohmann::json result = {
+        { "translation_units", analysis->translation_units },
+        { "seconds", analysis->seconds },
+        { "headers", nlohmann::json::array() },
+        { "targets", nlohmann::json::array() },
+      };
+      for (size_t i = 0; i < header_count; ++i) {
+        const auto& header = analysis->headers[i];
+        result["headers"].push_back({
+          { "path", header.path },
+          { "size", header.size },
+          { "closure_size", header.closure_size },
+          { "included_by", header.included_by },
+          { "cost", header.cost },
+        });
+      }
+      for (const auto& target : analysis->targets) {
+        result["targets"].push_back({
+          { "name", target.name },
+          { "translation_units", target.translation_units },
+          { "redundancy", target.redundancy },
+          { "unity_build_candidate", target.unity_build_candidate },
+          { "precompiled_header_candidates", target.precompiled_header_candidates },
+        });
+      }
+      fmt::print("{}\n", result.dump(2));
+      return;
+    }
+
+    fmt::print("Scanned {} translation units in {:.2f} sec\n\n", analysis->translation_units, analysis->seconds);
+    fmt::print("{:>12} {:>11} {:>12}  {}\n", "Cost (MiB)", "Included by", "Pulls in", "Header");
+    for (size_t i = 0; i < header_count; ++i) {
+      const auto& header = analysis->headers[i];
+      fmt::print(
+        "{:>12.1f} {:>11} {:>9.1f} KiB  {}\n",
+        header.cost / (1024.0 * 1024.0),
+        header.included_by,
+        header.closure_size / 1024.0,
+        header.path
+      );
+    }
+
+    for (const auto& target : analysis->targets) {
+      if (!target.unity_build_candidate && target.precompiled_header_candidates.empty()) {
+        continue;
+      }
+      fmt::print("\n{} ({} translation units, every file is read {:.1f} times on average)\n", target.name, target.translation_units, target.redundancy);
+      if (target.unity_build_candidate) {
+        fmt::print("  Unity build candidate (set_target_properties({} PROPERTIES UNITY_BUILD ON))\n", target.name);
+      }
+      for (const auto& header : target.precompiled_header_candidates) {
+        fmt::print("  Precompiled header candidate: {}\n", header);
+      }
+    }
+  });
+}
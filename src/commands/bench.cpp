@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "../benchmark.hpp"
+#include "../cmake.hpp"
+#include "../commands.hpp"
+#include "../utils.hpp"
+#include "../project.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+#include "subprocess.hpp"
+
+namespace {
+
+// Pins this process (and thus all benchmarks it starts) to a single core.
+void PinToCPU(unsigned cpu) {
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    spdlog::warn("Failed to pin benchmarks to CPU {}", cpu);
+  }
+#else
+  spdlog::warn("Pinning benchmarks to a CPU is only supported on Linux");
+#endif
+}
+
+// Benchmarks are the executables that link Google Benchmark, either a target
+// of the project (e.g. added using CPM) or an installed library.
+bool IsBenchmark(const ExecutableTarget& target) {
+  return std::any_of(target.libraries.begin(), target.libraries.end(), [](const std::string& library) {
+    auto library_name = Path(library).filename().string();
+    if (library_name.starts_with("-l")) {
+      library_name.erase(0, 2);
+    } else if (library_name.starts_with("lib")) {
+      library_name.erase(0, 3);
+    }
+    library_name.resize(std::min(library_name.find('.'), library_name.length()));
+    return library_name == "benchmark" || library_name == "benchmark_main";
+  });
+}
+
+}
+
+void AddBenchCommand(CLI::App& app) {
+  const auto bench_command = app.add_subcommand("bench", "Builds and runs the benchmarks of the project in release mode");
+
+  static std::string filter;
+  static std::string baseline_revision;
+  static unsigned repetitions = 10;
+  static double threshold = 5.0;
+  static unsigned cpu = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+  bench_command
+    ->add_option("filter", filter)
+    ->description("Only run benchmarks matching this regex");
+
+  bench_command
+    ->add_option("--compare", baseline_revision)
+    ->description("Git revision whose stored results are used as baseline");
+
+  bench_command
+    ->add_option("--repetitions", repetitions)
+    ->description("Number of repetitions of each benchmark (default: 10)");
+
+  bench_command
+    ->add_option("--threshold", threshold)
+    ->description("Slowdown in percent that is reported as regression (default: 5)");
+
+  bench_command
+    ->add_option("--cpu", cpu)
+    ->description("CPU the benchmarks are pinned to (default: last CPU)");
+
+  bench_command->callback([&]() {
+    const auto project = Project::Open(fs::current_path());
+    if (!project) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    // The benchmarks are read from CMake's file API, which only answers when
+    // the project is configured after asking.
+    const auto build_path = project->GetBuildPath("release");
+    const bool reconfigure = IsCodeModelOutdated(build_path, project->GetListFiles());
+    if (!RequestCodeModel(build_path) || !project->Configure(build_path, { "-DCMAKE_BUILD_TYPE=Release" }, reconfigure)) {
+      throw CLI::RuntimeError(-1);
+    }
+    const auto executables = GetExecutableTargets(build_path, "Release");
+    if (!executables) {
+      spdlog::error("Failed to determine the executables in {}", build_path.string());
+      throw CLI::RuntimeError(-1);
+    }
+
+    std::vector<ExecutableTarget> benchmarks;
+    std::copy_if(executables->begin(), executables->end(), std::back_inserter(benchmarks), IsBenchmark);
+    if (benchmarks.empty()) {
+      spdlog::error("The project does not contain any benchmarks, add one using cpm add benchmark <name>");
+      throw CLI::RuntimeError(-1);
+    }
+
+    std::vector<std::string> benchmark_names;
+    for (const auto& benchmark : benchmarks) {
+      benchmark_names.push_back(benchmark.name);
+    }
+    if (!BuildTargets(build_path, benchmark_names, { "--config", "Release" })) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    // Results of builds with uncommitted changes are kept separately so they
+    // are never used as baseline for the commit.
+    const auto revision = project->GetRevision();
+    std::string results_name = revision ? *revision : "unversioned";
+    if (revision && project->HasUncommittedChanges()) {
+      results_name += "-dirty";
+    }
+    const auto results_path = build_path / "benchmarks" / results_name;
+    if (!fs::exists(results_path) && !fs::create_directories(results_path)) {
+      spdlog::error("Failed to create directory {}", results_path.string());
+      throw CLI::RuntimeError(-1);
+    }
+
+    PinToCPU(cpu);
+
+    for (const auto& benchmark : benchmarks) {
+      std::vector<std::string> benchmark_command = {
+        benchmark.path.string(),
+        fmt::format("--benchmark_repetitions={}", repetitions),
+        fmt::format("--benchmark_out={}", (results_path / fmt::format("{}.json", benchmark.name)).string()),
+        "--benchmark_out_format=json",
+      };
+      if (filter.length() > 0) {
+        benchmark_command.push_back(fmt::format("--benchmark_filter={}", filter));
+      }
+
+      if (subprocess::Popen(benchmark_command).wait() != 0) {
+        spdlog::error("Failed to run benchmark {}", benchmark.name);
+        throw CLI::RuntimeError(-1);
+      }
+    }
+    spdlog::info("Stored results in {}", results_path.string());
+
+    if (baseline_revision.empty()) {
+      return;
+    }
+
+    const auto baseline_commit = project->GetRevision(baseline_revision);
+    if (!baseline_commit) {
+      spdlog::error("Unknown revision {}", baseline_revision);
+      throw CLI::RuntimeError(-1);
+    }
+    const auto baseline_path = build_path / "benchmarks" / *baseline_commit;
+    if (!fs::exists(baseline_path)) {
+      spdlog::error("No results stored for {}, check it out and run cpm bench first", baseline_revision);
+      throw CLI::RuntimeError(-1);
+    }
+
+    constexpr double kSignificanceLevel = 0.05;
+    unsigned regressions = 0;
+    fmt::print("\n{:<40} {:>14} {:>14} {:>9} {:>8}\n", "Benchmark", "Baseline", "Current", "Change", "p-value");
+    for (const auto& benchmark : benchmarks) {
+      const auto result_filename = fmt::format("{}.json", benchmark.name);
+      const auto baseline = ParseBenchmarkResults(baseline_path / result_filename);
+      const auto contender = ParseBenchmarkResults(results_path / result_filename);
+      if (!baseline || !contender) {
+        spdlog::warn("No results to compare for {}", benchmark.name);
+        continue;
+      }
+
+      for (const auto& comparison : CompareBenchmarks(*baseline, *contender)) {
+        const bool significant = comparison.p_value < kSignificanceLevel;
+        const bool regression = significant && comparison.change * 100.0 > threshold;
+        if (regression) {
+          ++regressions;
+        }
+        fmt::print(
+          "{:<40} {:>14.2f} {:>14.2f} {:>+8.1f}% {:>8.4f}{}\n",
+          comparison.name,
+          comparison.baseline_mean,
+          comparison.contender_mean,
+          comparison.change * 100.0,
+          comparison.p_value,
+          regression ? " REGRESSION" : (significant ? "" : " (not significant)")
+        );
+      }
+    }
+
+    if (regressions > 0) {
+      spdlog::error("{} benchmarks regressed by more than {}%", regressions, threshold);
+      throw CLI::RuntimeError(-1);
+    }
+  });
+}
@@ -1,43 +1,54 @@
+#include "../cmake.hpp"
 #include "../commands.hpp"
+#include "../pgo.hpp"
 #include "../utils.hpp"
 #include "../project.hpp"
-#include "spdlog/fmt/bundled/core.h"
+#include "CLI/Error.hpp"
 #include "spdlog/spdlog.h"
-#include "subprocess.hpp"
 
 void AddBuildCommand(CLI::App& app) {
   const auto configure_command = app.add_subcommand("build", "Builds the project");
 
   static std::string build_type;
+  static bool pgo = false;
+  static bool retrain = false;
 
   configure_command
     ->add_option("build_type", build_type)
     ->description("The build type debug|release");
 
+  configure_command
+    ->add_flag("--pgo", pgo)
+    ->description("Build with profile-guided and link time optimization using pgo.training_command from cpm.toml");
+
+  configure_command
+    ->add_flag("--retrain", retrain)
+    ->description("Record a new profile even if the sources did not change much (requires --pgo)");
+
   configure_command->callback([&]() {
     const auto project = Project::Open(fs::current_path());
     if (!project) {
       return;
     }
 
-    const auto build_path = project->path / "build";
-    if (!fs::exists(build_path)) {
-      spdlog::info("Project has not been configured yet");
-      if (!fs::create_directory(build_path)) {
-        spdlog::error("Failed to create build directory {}", build_path.string());
-        return;
+    if (pgo) {
+      if (build_type.length() > 0) {
+        spdlog::warn("Ignoring build type {}, profile-guided builds always use release mode", build_type);
       }
-      const auto configure_result = subprocess::call({ "cmake", ".." }, subprocess::cwd{ build_path.string().c_str() });
-      if (configure_result) {
-        spdlog::error("Failed to configure project");
-        return;
+      if (!BuildWithPGO(*project, retrain)) {
+        throw CLI::RuntimeError(-1);
       }
+      return;
     }
 
-    const auto configure_result = subprocess::call({ "cmake", "--build", "." }, subprocess::cwd{ build_path.string().c_str() });
-    if (configure_result) {
-      spdlog::error("Failed to build project");
-      return;
+    std::vector<std::string> cmake_arguments;
+    if (build_type.length() > 0) {
+      cmake_arguments.push_back(fmt::format("-DCMAKE_BUILD_TYPE={}", GetCMakeBuildType(build_type)));
+    }
+
+    const auto build_path = project->GetBuildPath(build_type);
+    if (!project->Configure(build_path, cmake_arguments) || !BuildTargets(build_path)) {
+      throw CLI::RuntimeError(-1);
     }
   });
 }
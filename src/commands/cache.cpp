@@ -0,0 +1,37 @@
+#include "../binary_cache.hpp"
+#include "../commands.hpp"
+#include "../context.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+
+void AddCacheCommand(CLI::App& app) {
+  const auto cache_command = app.add_subcommand("cache", "Shows statistics of the binary package cache");
+
+  static bool clear = false;
+
+  cache_command
+    ->add_flag("--clear", clear)
+    ->description("Removes all cached packages");
+
+  cache_command->callback([&]() {
+    if (clear) {
+      if (!ClearBinaryCache()) {
+        throw CLI::RuntimeError(-1);
+      }
+      return;
+    }
+
+    const auto statistics = GetBinaryCacheStatistics();
+    const auto lookups = statistics.hits + statistics.misses;
+    fmt::print("Location: {}\n", g_context.paths.binary_cache.string());
+    fmt::print("Packages: {}\n", statistics.entries);
+    fmt::print("Failed:   {}\n", statistics.failed_entries);
+    fmt::print("Size:     {:.1f} MiB\n", statistics.size / (1024.0 * 1024.0));
+    fmt::print(
+      "Hit rate: {:.1f}% ({} hits, {} misses)\n",
+      lookups > 0 ? 100.0 * statistics.hits / lookups : 0.0,
+      statistics.hits,
+      statistics.misses
+    );
+  });
+}
@@ -1,9 +1,10 @@
+#include "../cmake.hpp"
 #include "../commands.hpp"
 #include "../utils.hpp"
 #include "../project.hpp"
+#include "CLI/Error.hpp"
 #include "spdlog/fmt/bundled/core.h"
 #include "spdlog/spdlog.h"
-#include "subprocess.hpp"
 
 void AddConfigureCommand(CLI::App& app) {
   const auto configure_command = app.add_subcommand("configure", "Configures the cmake project");
@@ -20,15 +21,13 @@ void AddConfigureCommand(CLI::App& app) {
       return;
     }
 
-    const auto build_path = project->path / "build";
-    if (!fs::exists(build_path) && !fs::create_directory(build_path)) {
-      spdlog::error("Failed to create build directory {}", build_path.string());
-      return;
+    std::vector<std::string> cmake_arguments;
+    if (build_type.length() > 0) {
+      cmake_arguments.push_back(fmt::format("-DCMAKE_BUILD_TYPE={}", GetCMakeBuildType(build_type)));
     }
 
-    const auto configure = subprocess::check_output({ "cmake", ".." }, subprocess::cwd{ build_path.string().c_str() });
-    const std::string_view configure_output(configure.buf.data(), configure.length);
-
-    fmt::print("{}", configure_output);
+    if (!project->Configure(project->GetBuildPath(build_type), cmake_arguments, true)) {
+      throw CLI::RuntimeError(-1);
+    }
   });
 }
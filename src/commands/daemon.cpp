@@ -0,0 +1,38 @@
+#include "../commands.hpp"
+#include "../daemon.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+
+void AddDaemonCommand(CLI::App& app) {
+  const auto daemon_command = app.add_subcommand("daemon", "Runs a daemon keeping project and registry state in memory");
+
+  static bool stop = false;
+  static bool status = false;
+
+  daemon_command
+    ->add_flag("--stop", stop)
+    ->description("Stops the running daemon");
+
+  daemon_command
+    ->add_flag("--status", status)
+    ->description("Shows whether the daemon is running");
+
+  daemon_command->callback([&]() {
+    if (stop || status) {
+      const auto answer = QueryDaemon({ { "query", stop ? "shutdown" : "status" } });
+      if (!answer) {
+        spdlog::error("The daemon is not running");
+        throw CLI::RuntimeError(-1);
+      }
+      if (status) {
+        fmt::print("{}\n", (*answer)["result"].dump(2));
+      }
+      return;
+    }
+
+    if (!RunDaemon()) {
+      throw CLI::RuntimeError(-1);
+    }
+  });
+}
@@ -0,0 +1,21 @@
+#include "../commands.hpp"
+#include "../daemon.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+
+void AddOutdatedCommand(CLI::App& app) {
+  const auto outdated_command = app.add_subcommand("outdated", "Lists packages for which a newer version is available");
+
+  outdated_command->callback([&]() {
+    const auto answer = Query({ { "query", "outdated" } });
+    if (answer.contains("error")) {
+      spdlog::error("{}", answer["error"].get<std::string>());
+      throw CLI::RuntimeError(-1);
+    }
+
+    for (const auto& package : answer["result"]) {
+      fmt::print("{} -> {}\n", package["package"].get<std::string>(), package["latest"].get<std::string>());
+    }
+  });
+}
@@ -0,0 +1,27 @@
+#include "../commands.hpp"
+#include "../daemon.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+
+void AddSearchCommand(CLI::App& app) {
+  const auto search_command = app.add_subcommand("search", "Searches the registries for packages");
+
+  static std::string search_term;
+
+  search_command
+    ->add_option("search_term", search_term)
+    ->description("Part of the package name");
+
+  search_command->callback([&]() {
+    const auto answer = Query({ { "query", "search" }, { "argument", search_term } });
+    if (answer.contains("error")) {
+      spdlog::error("{}", answer["error"].get<std::string>());
+      throw CLI::RuntimeError(-1);
+    }
+
+    for (const auto& package_name : answer["result"]) {
+      fmt::print("{}\n", package_name.get<std::string>());
+    }
+  });
+}
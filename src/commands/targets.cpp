@@ -0,0 +1,21 @@
+#include "../commands.hpp"
+#include "../daemon.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+
+void AddTargetsCommand(CLI::App& app) {
+  const auto targets_command = app.add_subcommand("targets", "Lists the targets of the project");
+
+  targets_command->callback([&]() {
+    const auto answer = Query({ { "query", "targets" } });
+    if (answer.contains("error")) {
+      spdlog::error("{}", answer["error"].get<std::string>());
+      throw CLI::RuntimeError(-1);
+    }
+
+    for (const auto& target : answer["result"]) {
+      fmt::print("{} ({})\n", target["name"].get<std::string>(), target["type"].get<std::string>());
+    }
+  });
+}
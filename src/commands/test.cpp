@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+#include "../cmake.hpp"
+#include "../commands.hpp"
+#include "../ctest.hpp"
+#include "../utils.hpp"
+#include "../project.hpp"
+#include "CLI/Error.hpp"
+#include "spdlog/fmt/bundled/core.h"
+#include "spdlog/spdlog.h"
+#include "subprocess.hpp"
+
+namespace {
+
+// Parses a shard of the form i/n with 1 <= i <= n.
+std::optional<std::pair<unsigned, unsigned>> ParseShard(std::string_view shard) {
+  const auto parse_number = [](std::string_view number_string) -> std::optional<unsigned> {
+    unsigned number;
+    const auto [end, error] = std::from_chars(number_string.data(), number_string.data() + number_string.size(), number);
+    if (error != std::errc() || end != number_string.data() + number_string.size()) {
+      return std::nullopt;
+    }
+    return number;
+  };
+
+  const auto separator = shard.find('/');
+  if (separator == std::string_view::npos) {
+    return std::nullopt;
+  }
+  const auto index = parse_number(shard.substr(0, separator));
+  const auto count = parse_number(shard.substr(separator + 1));
+  if (!index || !count || *index < 1 || *count < *index) {
+    return std::nullopt;
+  }
+  return std::pair(*index, *count);
+}
+
+}
+
+void AddTestCommand(CLI::App& app) {
+  const auto test_command = app.add_subcommand("test", "Builds the project and runs its tests");
+
+  static unsigned jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  static bool failed = false;
+  static std::string shard;
+  static std::string history_path;
+
+  test_command
+    ->add_option("-j,--jobs", jobs)
+    ->description("Number of tests run in parallel (default: number of cores)");
+
+  test_command
+    ->add_flag("--failed", failed)
+    ->description("Only rerun the tests that failed in the last run");
+
+  test_command
+    ->add_option("--shard", shard)
+    ->description("Only run shard i of n (e.g. 2/4), split by historical test duration");
+
+  test_command
+    ->add_option("--history", history_path)
+    ->description("File storing the test durations, shards must use the same one (default: build/cpm-test-history.json)");
+
+  test_command->callback([&]() {
+    unsigned shard_index = 0;
+    unsigned shard_count = 1;
+    if (shard.length() > 0) {
+      const auto parsed_shard = ParseShard(shard);
+      if (!parsed_shard) {
+        spdlog::error("Invalid shard {}, expected i/n with 1 <= i <= n", shard);
+        throw CLI::RuntimeError(-1);
+      }
+      shard_index = parsed_shard->first - 1;
+      shard_count = parsed_shard->second;
+    }
+
+    const auto project = Project::Open(fs::current_path());
+    if (!project) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    const auto build_path = project->path / "build";
+    if (!project->Configure(build_path) || !BuildTargets(build_path)) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    const auto history_file_path = history_path.length() > 0 ? Path(history_path) : build_path / "cpm-test-history.json";
+    auto history = TestHistory::Load(history_file_path);
+    if (!history) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    const auto all_tests = ListTests(build_path);
+    if (!all_tests) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    std::vector<std::string> tests;
+    if (failed) {
+      // Failed tests that have been removed since are skipped.
+      for (const auto& test : *all_tests) {
+        if (std::find(history->failed_tests.begin(), history->failed_tests.end(), test) != history->failed_tests.end()) {
+          tests.push_back(test);
+        }
+      }
+      if (tests.empty()) {
+        spdlog::info("No tests failed in the last run");
+        return;
+      }
+    } else {
+      tests = *all_tests;
+    }
+
+    if (shard_count > 1) {
+      if (history->tests.empty()) {
+        spdlog::warn("No test durations recorded in {}, splitting the tests by count", history_file_path.string());
+      }
+      tests = SelectShard(tests, *history, shard_index, shard_count);
+      if (tests.empty()) {
+        spdlog::info("Shard {} does not contain any tests", shard);
+        return;
+      }
+    }
+
+    // CTest starts the failed tests and the ones with the highest cost (i.e.,
+    // the longest average duration) first. Its cost data is replaced by the
+    // history so that fresh build directories benefit as well.
+    if (!history->WriteCTestCostData(build_path)) {
+      throw CLI::RuntimeError(-1);
+    }
+
+    const auto junit_file_path = build_path / "Testing" / "cpm-test-results.xml";
+    std::vector<std::string> ctest_command = {
+      "ctest",
+      "--output-on-failure",
+      "--parallel", std::to_string(jobs),
+      "--output-junit", junit_file_path.string(),
+    };
+    if (failed || shard_count > 1) {
+      const auto selection_file_path = build_path / "Testing" / "cpm-test-selection.txt";
+      if (!WriteTestSelection(selection_file_path, *all_tests, tests)) {
+        throw CLI::RuntimeError(-1);
+      }
+      ctest_command.push_back("--tests-information");
+      ctest_command.push_back(selection_file_path.string());
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto ctest_result = subprocess::Popen(ctest_command, subprocess::cwd{ build_path.string().c_str() }).wait();
+    const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start_time;
+
+    const auto results = ParseJUnitResults(junit_file_path);
+    const auto test_time = std::accumulate(
+      results.begin(),
+      results.end(),
+      0.0,
+      [](double sum, const auto& result) { return sum + result.duration; }
+    );
+    if (results.size() > 0) {
+      history->Record(results);
+      history->Save(history_file_path);
+    }
+
+    const auto failed_count = std::count_if(results.begin(), results.end(), [](const auto& result) { return !result.passed; });
+    fmt::print(
+      "Ran {} tests ({} failed): {:.2f} sec wall time, {:.2f} sec summed test time ({:.1f}x)\n",
+      results.size(),
+      failed_count,
+      wall_time.count(),
+      test_time,
+      wall_time.count() > 0 ? test_time / wall_time.count() : 0.0
+    );
+
+    if (ctest_result != 0) {
+      throw CLI::RuntimeError(-1);
+    }
+  });
+}
@@ -15,6 +15,7 @@ bool Context::Init() {
   g_context.paths.cache = g_context.paths.home / ".cache" / "cpm-cli";
   g_context.paths.registries = g_context.paths.cache / "registries";
   g_context.paths.cpm_cache = g_context.paths.cache / "cpm_cache";
+  g_context.paths.binary_cache = g_context.paths.cache / "binary_cache";
 
   if (!fs::exists(g_context.paths.config_directory) && !fs::create_directories(g_context.paths.config_directory)) {
     spdlog::error("Failed to create directory {}", g_context.paths.config_directory.string());
@@ -42,12 +43,22 @@ bool Context::Init() {
       return false;
     }
   } else {
-    g_context.config = toml::parse_file(g_context.paths.config_file.string());
+    return g_context.ReloadConfig();
   }
 
   return true;
 }
 
+bool Context::ReloadConfig() {
+  try {
+    config = toml::parse_file(paths.config_file.string());
+    return true;
+  } catch (const toml::parse_error& error) {
+    spdlog::error("Failed to parse {}: {}", paths.config_file.string(), error.description());
+    return false;
+  }
+}
+
 bool Context::SetupRegistries() const {
   const auto registries = config.at("registries").as_table();
   if (!registries) {
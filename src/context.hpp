@@ -12,12 +12,20 @@ struct Context {
     Path cache;
     Path registries;
     Path cpm_cache;
+    Path binary_cache;
     Path cmake;
   } paths;
 
   toml::table config;
 
+  // Whether the registries are updated whenever packages are looked up. The
+  // daemon updates them periodically on its worker thread instead.
+  bool update_registries_on_use = true;
+
   static bool Init();
 
+  // Re-reads the user configuration file.
+  bool ReloadConfig();
+
   bool SetupRegistries() const;
 } extern g_context;
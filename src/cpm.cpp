@@ -15,6 +15,14 @@ int main(int argc, char* argv[]) {
   AddAddCommand(app);
   AddConfigureCommand(app);
   AddBuildCommand(app);
+  AddTestCommand(app);
+  AddBenchCommand(app);
+  AddCacheCommand(app);
+  AddAnalyzeCommand(app);
+  AddDaemonCommand(app);
+  AddTargetsCommand(app);
+  AddOutdatedCommand(app);
+  AddSearchCommand(app);
   app.require_subcommand();
 
   CLI11_PARSE(app, argc, argv);
@@ -0,0 +1,237 @@
+#include "ctest.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <numeric>
+#include <regex>
+#include <set>
+
+#include "nlohmann/json.hpp"
+#include "spdlog/fmt/bundled/format.h"
+#include "spdlog/spdlog.h"
+#include "subprocess.hpp"
+
+namespace {
+
+// Recent runs are weighted more than older ones once a test ran this often.
+constexpr unsigned kMaxAveragedRuns = 10;
+
+std::string UnescapeXML(std::string_view text) {
+  static const std::map<std::string, std::string, std::less<>> entities = {
+    { "amp", "&" },
+    { "lt", "<" },
+    { "gt", ">" },
+    { "quot", "\"" },
+    { "apos", "'" },
+  };
+
+  std::string unescaped;
+  while (true) {
+    const auto entity_begin = text.find('&');
+    const auto entity_end = text.find(';', entity_begin);
+    if (entity_begin == std::string_view::npos || entity_end == std::string_view::npos) {
+      break;
+    }
+    unescaped += text.substr(0, entity_begin);
+
+    const auto entity = text.substr(entity_begin + 1, entity_end - entity_begin - 1);
+    unsigned code_point = 0;
+    if (const auto replacement = entities.find(entity); replacement != entities.end()) {
+      unescaped += replacement->second;
+    } else if (entity.starts_with("#x") && std::from_chars(entity.data() + 2, entity.data() + entity.size(), code_point, 16).ec == std::errc() && code_point < 0x80) {
+      unescaped += static_cast<char>(code_point);
+    } else if (entity.starts_with('#') && std::from_chars(entity.data() + 1, entity.data() + entity.size(), code_point).ec == std::errc() && code_point < 0x80) {
+      unescaped += static_cast<char>(code_point);
+    } else {
+      unescaped += text.substr(entity_begin, entity_end - entity_begin + 1);
+    }
+    text.remove_prefix(entity_end + 1);
+  }
+  unescaped += text;
+
+  return unescaped;
+}
+
+}
+
+std::optional<TestHistory> TestHistory::Load(const Path& history_path) {
+  TestHistory history;
+
+  std::ifstream history_file(history_path);
+  if (!history_file.is_open()) {
+    return history;
+  }
+
+  try {
+    const auto history_json = nlohmann::json::parse(history_file);
+    for (const auto& [name, test] : history_json.at("tests").items()) {
+      history.tests[name] = {
+        .duration = test.at("duration"),
+        .runs = test.at("runs"),
+      };
+    }
+    history.failed_tests = history_json.at("failed_tests").get<std::vector<std::string>>();
+  } catch (const std::exception& exception) {
+    spdlog::error("Failed to read test history {}: {}", history_path.string(), exception.what());
+    return std::nullopt;
+  }
+
+  return history;
+}
+
+bool TestHistory::Save(const Path& history_path) const {
+  nlohmann::json history_json = {
+    { "tests", nlohmann::json::object() },
+    { "failed_tests", failed_tests },
+  };
+  for (const auto& [name, test] : tests) {
+    history_json["tests"][name] = {
+      { "duration", test.duration },
+      { "runs", test.runs },
+    };
+  }
+
+  if (!WriteFile(history_path, history_json.dump(2) + '\n')) {
+    spdlog::error("Failed to write test history {}", history_path.string());
+    return false;
+  }
+  return true;
+}
+
+void TestHistory::Record(const std::vector<TestResult>& results) {
+  failed_tests.clear();
+  for (const auto& result : results) {
+    auto& test = tests.try_emplace(result.name, RecordedTest{ .duration = 0.0, .runs = 0 }).first->second;
+    test.runs = std::min(test.runs + 1, kMaxAveragedRuns);
+    test.duration += (result.duration - test.duration) / test.runs;
+    if (!result.passed) {
+      failed_tests.push_back(result.name);
+    }
+  }
+}
+
+bool TestHistory::WriteCTestCostData(const Path& build_path) const {
+  const auto cost_data_path = build_path / "Testing" / "Temporary";
+  if (!fs::exists(cost_data_path) && !fs::create_directories(cost_data_path)) {
+    spdlog::error("Failed to create directory {}", cost_data_path.string());
+    return false;
+  }
+
+  // Each line contains "<name> <number of runs> <average duration>" followed
+  // by a line containing "---" and the names of the failed tests.
+  std::string cost_data;
+  for (const auto& [name, test] : tests) {
+    cost_data += fmt::format("{} {} {}\n", name, test.runs, test.duration);
+  }
+  cost_data += "---\n";
+  for (const auto& failed_test : failed_tests) {
+    cost_data += failed_test + '\n';
+  }
+
+  if (!WriteFile(cost_data_path / "CTestCostData.txt", cost_data)) {
+    spdlog::error("Failed to write {}", (cost_data_path / "CTestCostData.txt").string());
+    return false;
+  }
+  return true;
+}
+
+double TestHistory::GetExpectedDuration(const std::string& test_name) const {
+  if (const auto test = tests.find(test_name); test != tests.end()) {
+    return test->second.duration;
+  } else if (tests.size() > 0) {
+    const auto total_duration = std::accumulate(
+      tests.begin(),
+      tests.end(),
+      0.0,
+      [](double sum, const auto& entry) { return sum + entry.second.duration; }
+    );
+    return total_duration / tests.size();
+  } else {
+    return 1.0;
+  }
+}
+
+std::optional<std::vector<std::string>> ListTests(const Path& build_path) {
+  try {
+    const auto output = subprocess::check_output({ "ctest", "--show-only=json-v1" }, subprocess::cwd{ build_path.string().c_str() });
+    const auto test_list = nlohmann::json::parse(std::string_view(output.buf.data(), output.length));
+
+    std::vector<std::string> tests;
+    for (const auto& test : test_list.at("tests")) {
+      tests.push_back(test.at("name"));
+    }
+    return tests;
+  } catch (const std::exception& exception) {
+    spdlog::error("Failed to list tests: {}", exception.what());
+    return std::nullopt;
+  }
+}
+
+std::vector<std::string> SelectShard(std::vector<std::string> tests, const TestHistory& history, unsigned shard_index, unsigned shard_count) {
+  // Assign the longest tests first, each one to the shard with the least total
+  // duration so far.
+  std::sort(tests.begin(), tests.end(), [&](const auto& lhs, const auto& rhs) {
+    const auto lhs_duration = history.GetExpectedDuration(lhs);
+    const auto rhs_duration = history.GetExpectedDuration(rhs);
+    return lhs_duration != rhs_duration ? lhs_duration > rhs_duration : lhs < rhs;
+  });
+
+  std::vector<double> shard_durations(shard_count, 0.0);
+  std::vector<std::string> shard_tests;
+  for (const auto& test : tests) {
+    const auto shard = std::min_element(shard_durations.begin(), shard_durations.end()) - shard_durations.begin();
+    shard_durations[shard] += history.GetExpectedDuration(test);
+    if (shard == shard_index) {
+      shard_tests.push_back(test);
+    }
+  }
+
+  return shard_tests;
+}
+
+bool WriteTestSelection(const Path& selection_file_path, const std::vector<std::string>& all_tests, const std::vector<std::string>& selected_tests) {
+  const std::set<std::string> selected_test_names(selected_tests.begin(), selected_tests.end());
+
+  // The format is start,end,stride followed by test numbers, which start at 1.
+  std::string selection = "0,0,0";
+  for (size_t i = 0; i < all_tests.size(); ++i) {
+    if (selected_test_names.contains(all_tests[i])) {
+      selection += fmt::format(",{}", i + 1);
+    }
+  }
+
+  // CTest ignores the last number unless the line is terminated.
+  if (!WriteFile(selection_file_path, selection + '\n')) {
+    spdlog::error("Failed to write {}", selection_file_path.string());
+    return false;
+  }
+  return true;
+}
+
+std::vector<TestResult> ParseJUnitResults(const Path& junit_file_path) {
+  std::vector<TestResult> results;
+
+  const auto junit_content = ReadFile(junit_file_path);
+  if (!junit_content) {
+    return results;
+  }
+
+  std::regex testcase_definition(R"xml(<testcase\s+name="([^"]*)"[^>]*\stime="([0-9.eE+-]+)"[^>]*\sstatus="(\w+)")xml");
+  std::smatch match;
+  std::string remaining_content(*junit_content);
+  while (std::regex_search(remaining_content, match, testcase_definition)) {
+    // Besides run and fail, CTest reports disabled and notrun.
+    const auto status = match[3].str();
+    if (status == "run" || status == "fail") {
+      results.push_back({
+        .name = UnescapeXML(match[1].str()),
+        .duration = std::stod(match[2].str()),
+        .passed = status == "run",
+      });
+    }
+    remaining_content = match.suffix();
+  }
+
+  return results;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+struct TestResult {
+  std::string name;
+  double duration;
+  bool passed;
+};
+
+// Durations of the tests of a project, stored in a file that can be shared
+// between machines (e.g. passed between CI jobs) so that all of them split the
+// tests the same way.
+struct TestHistory {
+  struct RecordedTest {
+    // Average duration in seconds over the last runs.
+    double duration;
+    unsigned runs;
+  };
+  std::map<std::string, RecordedTest> tests;
+  std::vector<std::string> failed_tests;
+
+  // Reads the history, an empty history is returned if the file does not exist.
+  static std::optional<TestHistory> Load(const Path& history_path);
+
+  bool Save(const Path& history_path) const;
+
+  // Adds the durations of a test run and replaces the failed tests with the ones of the run.
+  void Record(const std::vector<TestResult>& results);
+
+  // Returns the recorded duration or the average duration for unknown tests.
+  double GetExpectedDuration(const std::string& test_name) const;
+
+  // Writes the history as the cost data CTest uses to start the failed and
+  // the longest tests first.
+  bool WriteCTestCostData(const Path& build_path) const;
+};
+
+// Returns the names of all tests known to CTest, ordered by their test number.
+std::optional<std::vector<std::string>> ListTests(const Path& build_path);
+
+// Splits the tests into shard_count shards of roughly equal expected duration
+// and returns the tests of shard shard_index (starting at 0). The result only
+// depends on the tests and the history, so CI nodes reading the same history
+// file compute the same split.
+std::vector<std::string> SelectShard(std::vector<std::string> tests, const TestHistory& history, unsigned shard_index, unsigned shard_count);
+
+// Writes a file for ctest -I that selects exactly the given tests by their
+// number. Unlike a regex of all names it does not hit the limits of the
+// command line for large selections.
+bool WriteTestSelection(const Path& selection_file_path, const std::vector<std::string>& all_tests, const std::vector<std::string>& selected_tests);
+
+// Parses the JUnit file written by ctest --output-junit. Disabled tests and
+// tests that could not be run are skipped.
+std::vector<TestResult> ParseJUnitResults(const Path& junit_file_path);
@@ -0,0 +1,680 @@
+#include "daemon.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+#include "context.hpp"
+#include "project.hpp"
+#include "registry.hpp"
+#include "repository.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Answers are dropped after this time even if none of the watched files changed
+// as they may depend on the tags of remote repositories.
+constexpr auto kAnswerLifetime = std::chrono::minutes(10);
+
+// The registries are pulled by the worker thread at this interval.
+constexpr auto kRegistryUpdateInterval = std::chrono::minutes(10);
+
+// Clients fall back to answering the query themselves if the daemon takes longer.
+constexpr int kClientTimeoutSeconds = 30;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+std::optional<sockaddr_un> GetDaemonSocketAddress() {
+  const auto socket_path = GetDaemonSocketPath().string();
+
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.length() >= sizeof(address.sun_path)) {
+    spdlog::error("Daemon socket path {} is too long", socket_path);
+    return std::nullopt;
+  }
+  std::memcpy(address.sun_path, socket_path.c_str(), socket_path.length() + 1);
+
+  return address;
+}
+
+int ConnectToDaemon() {
+  const auto address = GetDaemonSocketAddress();
+  if (!address) {
+    return -1;
+  }
+
+  const int socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (socket_fd < 0) {
+    return -1;
+  }
+
+  if (connect(socket_fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0) {
+    close(socket_fd);
+    return -1;
+  }
+
+  return socket_fd;
+}
+
+bool WriteLine(int fd, std::string line) {
+  line.push_back('\n');
+
+  std::string_view remaining(line);
+  while (remaining.length() > 0) {
+    const auto written = send(fd, remaining.data(), remaining.length(), kSendFlags);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    remaining.remove_prefix(written);
+  }
+
+  return true;
+}
+
+std::optional<std::string> ReadLine(int fd) {
+  std::string line;
+  char buffer[4096];
+  while (true) {
+    const auto received = recv(fd, buffer, sizeof(buffer), 0);
+    if (received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return std::nullopt;
+    } else if (received == 0) {
+      return std::nullopt;
+    }
+
+    line.append(buffer, received);
+    if (const auto line_end = line.find('\n'); line_end != std::string::npos) {
+      line.resize(line_end);
+      return line;
+    }
+  }
+}
+
+nlohmann::json OpenProjectAndAnswer(const nlohmann::json& query) {
+  const auto project = Project::Open(query.value("cwd", fs::current_path().string()));
+  if (!project) {
+    return { { "error", "The current folder does not seem to be a cmake project" } };
+  }
+
+  const std::string query_name = query.at("query");
+  nlohmann::json result = nlohmann::json::array();
+  if (query_name == "targets") {
+    for (const auto& target : project->GetTargets()) {
+      result.push_back({
+        { "name", target.name },
+        { "type", target.type },
+        { "path", target.path.string() },
+      });
+    }
+  } else {
+    for (const auto& package_definition : project->GetPackages()) {
+      const auto package = PackageReference::Parse(package_definition);
+      if (!package) {
+        continue;
+      }
+      const auto pinned_version = package->GetPinnedVersion();
+      if (!pinned_version) {
+        // Packages pinned to commits are never reported as outdated.
+        continue;
+      }
+      const auto latest_version = package->repository.QueryLatestVersion();
+      if (latest_version && *pinned_version < latest_version->version) {
+        result.push_back({
+          { "package", package_definition },
+          { "latest", package->repository.GetCPMDefinition(latest_version) },
+        });
+      }
+    }
+  }
+
+  return { { "result", result } };
+}
+
+#ifdef __linux__
+
+struct DaemonState {
+  int inotify_fd = -1;
+  std::map<int, Path> watched_directories;
+  std::set<Path> watched_projects;
+
+  struct CachedAnswer {
+    std::chrono::steady_clock::time_point time;
+    nlohmann::json answer;
+  };
+  std::map<std::string, CachedAnswer> answers;
+  // Incremented whenever the answers are invalidated. Answers of queries that
+  // started before are not cached.
+  unsigned generation = 0;
+  // The configuration is only reloaded while the worker is idle as it reads it.
+  bool reload_pending = false;
+
+  // Queries that need the network (i.e., resolve and outdated) are answered
+  // one at a time by a worker thread, so they do not block the clients of
+  // other queries. Clients sending the same query wait for the same answer.
+  struct PendingQuery {
+    nlohmann::json query;
+    std::vector<int> client_fds;
+    unsigned generation;
+  };
+  std::map<std::string, PendingQuery> pending_queries;
+  std::deque<std::string> queued_queries;
+  bool worker_busy = false;
+  // Registry updates are run by the worker as well, so queries answered right
+  // away only read the registries and never wait for git.
+  std::chrono::steady_clock::time_point next_registry_update;
+
+  // Shared with the worker thread.
+  struct WorkerAnswer {
+    std::string cache_key;
+    nlohmann::json answer;
+    bool cacheable;
+  };
+  std::mutex worker_mutex;
+  std::condition_variable worker_condition;
+  std::optional<nlohmann::json> worker_query;
+  std::vector<WorkerAnswer> worker_answers;
+  bool worker_stop = false;
+  // Signaled by the worker when it finished a query.
+  int worker_event_fd = -1;
+  std::thread worker;
+
+  void Watch(const Path& directory) {
+    for (const auto& [_, watched_directory] : watched_directories) {
+      if (watched_directory == directory) {
+        return;
+      }
+    }
+
+    const int watch = inotify_add_watch(
+      inotify_fd,
+      directory.c_str(),
+      IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    );
+    if (watch < 0) {
+      spdlog::warn("Failed to watch {}: {}", directory.string(), std::strerror(errno));
+    } else {
+      watched_directories[watch] = directory;
+    }
+  }
+
+  void WatchRegistries() {
+    Watch(g_context.paths.config_directory);
+    Watch(g_context.paths.registries);
+    if (const auto registries = g_context.config["registries"].as_table(); registries) {
+      for (const auto& [name, _] : *registries) {
+        const auto registry_path = g_context.paths.registries / name.str();
+        if (fs::is_directory(registry_path)) {
+          Watch(registry_path);
+        }
+      }
+    }
+  }
+
+  void WatchProject(const nlohmann::json& query) {
+    const auto project = Project::Open(query.value("cwd", fs::current_path().string()));
+    if (!project || !watched_projects.insert(project->path).second) {
+      return;
+    }
+    for (const auto& list_file : project->GetListFiles()) {
+      Watch(list_file.parent_path());
+    }
+  }
+
+  void HandleFileEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    const auto length = read(inotify_fd, buffer, sizeof(buffer));
+    if (length <= 0) {
+      return;
+    }
+
+    bool invalidate = false;
+    bool reload_config = false;
+    for (ssize_t offset = 0; offset < length;) {
+      const auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      // Events were dropped, any of the watched files may have changed.
+      if (event->mask & IN_Q_OVERFLOW) {
+        reload_config = true;
+        invalidate = true;
+        continue;
+      }
+
+      const auto directory = watched_directories.find(event->wd);
+      if (directory == watched_directories.end()) {
+        continue;
+      }
+
+      const std::string_view name = event->len > 0 ? event->name : "";
+      if (directory->second == g_context.paths.config_directory) {
+        if (name == g_context.paths.config_file.filename().string()) {
+          reload_config = true;
+          invalidate = true;
+        }
+      } else if (directory->second == g_context.paths.registries || name.ends_with(".json")) {
+        invalidate = true;
+      } else if (name == "CMakeLists.txt") {
+        invalidate = true;
+      }
+    }
+
+    if (reload_config) {
+      reload_pending = true;
+      ReloadConfigIfIdle();
+    }
+    if (invalidate) {
+      answers.clear();
+      ++generation;
+      ClearVersionCache();
+      // New subdirectories or registries may have been added.
+      watched_projects.clear();
+      WatchRegistries();
+    }
+  }
+
+  void ReloadConfigIfIdle() {
+    if (!reload_pending || worker_busy) {
+      return;
+    }
+    spdlog::info("Reload {}", g_context.paths.config_file.string());
+    g_context.ReloadConfig();
+    // Registries that were added are cloned right away.
+    next_registry_update = {};
+    reload_pending = false;
+    DispatchQuery();
+  }
+
+  // Remembers the answer unless it may be outdated or incomplete.
+  void CacheAnswer(const std::string& cache_key, const nlohmann::json& query, const nlohmann::json& answer, unsigned answer_generation) {
+    if (answer_generation != generation || reload_pending) {
+      return;
+    }
+    answers[cache_key] = { .time = std::chrono::steady_clock::now(), .answer = answer };
+    const std::string query_name = query.value("query", "");
+    if (query_name == "targets" || query_name == "outdated") {
+      WatchProject(query);
+    } else {
+      WatchRegistries();
+    }
+  }
+
+  // Answers the query right away if possible, otherwise the answer is sent
+  // once the worker computed it. Takes ownership of the client socket.
+  void Answer(int client_fd, const nlohmann::json& query) {
+    const std::string query_name = query.value("query", "");
+    if (query_name == "status") {
+      WriteLine(client_fd, nlohmann::json({
+        { "result", {
+          { "pid", getpid() },
+          { "cached_answers", answers.size() },
+          { "pending_queries", pending_queries.size() },
+          { "watched_directories", watched_directories.size() },
+        } },
+      }).dump());
+      close(client_fd);
+      return;
+    }
+
+    const auto cache_key = query.dump();
+    if (const auto cached = answers.find(cache_key); cached != answers.end()) {
+      if (std::chrono::steady_clock::now() - cached->second.time < kAnswerLifetime) {
+        WriteLine(client_fd, cached->second.answer.dump());
+        close(client_fd);
+        return;
+      }
+      answers.erase(cached);
+    }
+
+    if (query_name == "resolve" || query_name == "outdated") {
+      auto [pending_query, inserted] = pending_queries.try_emplace(cache_key, PendingQuery{ .query = query, .client_fds = {}, .generation = generation });
+      pending_query->second.client_fds.push_back(client_fd);
+      if (inserted) {
+        queued_queries.push_back(cache_key);
+        DispatchQuery();
+      }
+      return;
+    }
+
+    const auto answer = AnswerQuery(query);
+    WriteLine(client_fd, answer.dump());
+    close(client_fd);
+    if (!answer.contains("error")) {
+      CacheAnswer(cache_key, query, answer, generation);
+    }
+  }
+
+  void DispatchQuery() {
+    if (worker_busy || reload_pending) {
+      return;
+    }
+
+    nlohmann::json query;
+    if (const auto now = std::chrono::steady_clock::now(); now >= next_registry_update) {
+      next_registry_update = now + kRegistryUpdateInterval;
+      query = { { "query", "update_registries" } };
+    } else if (!queued_queries.empty()) {
+      query = pending_queries.at(queued_queries.front()).query;
+      queued_queries.pop_front();
+    } else {
+      return;
+    }
+    {
+      std::lock_guard lock(worker_mutex);
+      worker_query = std::move(query);
+    }
+    worker_busy = true;
+    worker_condition.notify_one();
+  }
+
+  // Time until the next registry update in milliseconds, as used by poll.
+  int GetRegistryUpdateTimeout() const {
+    const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(next_registry_update - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<std::chrono::milliseconds::rep>(remaining.count(), 0));
+  }
+
+  void HandleWorkerAnswers() {
+    uint64_t count;
+    if (read(worker_event_fd, &count, sizeof(count)) < 0) {
+      return;
+    }
+
+    std::vector<WorkerAnswer> finished_answers;
+    {
+      std::lock_guard lock(worker_mutex);
+      finished_answers.swap(worker_answers);
+    }
+    for (const auto& finished_answer : finished_answers) {
+      const auto pending_query = pending_queries.find(finished_answer.cache_key);
+      if (pending_query == pending_queries.end()) {
+        continue;
+      }
+      const auto answer = finished_answer.answer.dump();
+      for (const int client_fd : pending_query->second.client_fds) {
+        WriteLine(client_fd, answer);
+        close(client_fd);
+      }
+      if (finished_answer.cacheable) {
+        CacheAnswer(finished_answer.cache_key, pending_query->second.query, finished_answer.answer, pending_query->second.generation);
+      }
+      pending_queries.erase(pending_query);
+    }
+
+    worker_busy = false;
+    ReloadConfigIfIdle();
+    DispatchQuery();
+  }
+
+  void RunWorker() {
+    while (true) {
+      nlohmann::json query;
+      {
+        std::unique_lock lock(worker_mutex);
+        worker_condition.wait(lock, [this]() { return worker_stop || worker_query; });
+        if (worker_stop) {
+          return;
+        }
+        query = std::move(*worker_query);
+        worker_query.reset();
+      }
+
+      nlohmann::json answer;
+      bool cacheable = false;
+      if (query.value("query", "") == "update_registries") {
+        // Changed registry files invalidate the answers through inotify.
+        g_context.SetupRegistries();
+      } else {
+        // Failed tag queries (e.g. due to rate limits) look like packages
+        // without versions, such answers are not cached.
+        const auto failed_version_queries = GetFailedVersionQueryCount();
+        answer = AnswerQuery(query);
+        cacheable = !answer.contains("error") && GetFailedVersionQueryCount() == failed_version_queries;
+      }
+
+      {
+        std::lock_guard lock(worker_mutex);
+        worker_answers.push_back({ .cache_key = query.dump(), .answer = std::move(answer), .cacheable = cacheable });
+      }
+      const uint64_t count = 1;
+      if (write(worker_event_fd, &count, sizeof(count)) < 0) {
+        spdlog::error("Failed to signal answer: {}", std::strerror(errno));
+      }
+    }
+  }
+
+  void StopWorker() {
+    {
+      std::lock_guard lock(worker_mutex);
+      worker_stop = true;
+    }
+    worker_condition.notify_one();
+    if (worker.joinable()) {
+      worker.join();
+    }
+    for (const auto& [_, pending_query] : pending_queries) {
+      for (const int client_fd : pending_query.client_fds) {
+        close(client_fd);
+      }
+    }
+    pending_queries.clear();
+  }
+};
+
+void RequestStop(int) {
+  stop_requested = 1;
+}
+
+#endif
+
+}
+
+Path GetDaemonSocketPath() {
+  return g_context.paths.cache / "daemon.sock";
+}
+
+nlohmann::json AnswerQuery(const nlohmann::json& query) {
+  try {
+    const std::string query_name = query.value("query", "");
+    const std::string argument = query.value("argument", "");
+
+    if (query_name == "resolve") {
+      if (const auto cpm_definition = ResolvePackageDefinition(argument); cpm_definition) {
+        return { { "result", *cpm_definition } };
+      } else {
+        return { { "error", fmt::format("Cannot find package {}", argument) } };
+      }
+    } else if (query_name == "search") {
+      return { { "result", SearchPackages(argument) } };
+    } else if (query_name == "targets" || query_name == "outdated") {
+      return OpenProjectAndAnswer(query);
+    } else {
+      return { { "error", fmt::format("Unknown query {}", query_name) } };
+    }
+  } catch (const std::exception& exception) {
+    return { { "error", exception.what() } };
+  }
+}
+
+std::optional<nlohmann::json> QueryDaemon(const nlohmann::json& query) {
+  const int socket_fd = ConnectToDaemon();
+  if (socket_fd < 0) {
+    return std::nullopt;
+  }
+
+  timeval timeout = { .tv_sec = kClientTimeoutSeconds, .tv_usec = 0 };
+  setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::optional<nlohmann::json> answer;
+  if (WriteLine(socket_fd, query.dump())) {
+    if (const auto line = ReadLine(socket_fd); line) {
+      answer = nlohmann::json::parse(*line, nullptr, false);
+      if (answer->is_discarded()) {
+        answer.reset();
+      }
+    }
+  }
+  close(socket_fd);
+
+  if (!answer) {
+    spdlog::warn("Daemon did not answer, falling back to local query");
+  }
+  return answer;
+}
+
+nlohmann::json Query(const nlohmann::json& query) {
+  auto query_with_cwd = query;
+  if (!query_with_cwd.contains("cwd")) {
+    query_with_cwd["cwd"] = fs::current_path().string();
+  }
+
+  if (auto answer = QueryDaemon(query_with_cwd); answer) {
+    return *answer;
+  } else {
+    return AnswerQuery(query_with_cwd);
+  }
+}
+
+bool RunDaemon() {
+#ifdef __linux__
+  const auto address = GetDaemonSocketAddress();
+  if (!address) {
+    return false;
+  }
+
+  if (const int running_daemon = ConnectToDaemon(); running_daemon >= 0) {
+    close(running_daemon);
+    spdlog::error("The daemon is already running");
+    return false;
+  }
+  // The socket file of a daemon that was not shut down properly.
+  fs::remove(GetDaemonSocketPath());
+
+  DaemonState state;
+  state.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (state.inotify_fd < 0) {
+    spdlog::error("Failed to initialize inotify: {}", std::strerror(errno));
+    return false;
+  }
+  state.worker_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (state.worker_event_fd < 0) {
+    spdlog::error("Failed to create event: {}", std::strerror(errno));
+    close(state.inotify_fd);
+    return false;
+  }
+
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0 ||
+      bind(listen_fd, reinterpret_cast<const sockaddr*>(&*address), sizeof(*address)) != 0 ||
+      listen(listen_fd, 16) != 0) {
+    spdlog::error("Failed to listen on {}: {}", GetDaemonSocketPath().string(), std::strerror(errno));
+    close(state.inotify_fd);
+    close(state.worker_event_fd);
+    if (listen_fd >= 0) {
+      close(listen_fd);
+    }
+    return false;
+  }
+
+  std::signal(SIGINT, RequestStop);
+  std::signal(SIGTERM, RequestStop);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  g_context.update_registries_on_use = false;
+  state.WatchRegistries();
+
+  state.worker = std::thread([&state]() { state.RunWorker(); });
+  state.DispatchQuery();
+
+  spdlog::info("Listening on {}", GetDaemonSocketPath().string());
+
+  pollfd poll_fds[] = {
+    { .fd = state.inotify_fd, .events = POLLIN },
+    { .fd = state.worker_event_fd, .events = POLLIN },
+    { .fd = listen_fd, .events = POLLIN },
+  };
+  while (!stop_requested) {
+    // While the worker is busy the update is dispatched once it is done.
+    if (poll(poll_fds, 3, state.worker_busy ? -1 : state.GetRegistryUpdateTimeout()) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error("Failed to wait for requests: {}", std::strerror(errno));
+      break;
+    }
+
+    // File events are handled first so queries never see outdated answers.
+    if (poll_fds[0].revents & POLLIN) {
+      state.HandleFileEvents();
+    }
+
+    if (poll_fds[1].revents & POLLIN) {
+      state.HandleWorkerAnswers();
+    }
+
+    if (poll_fds[2].revents & POLLIN) {
+      const int client_fd = accept(listen_fd, nullptr, nullptr);
+      if (client_fd < 0) {
+        continue;
+      }
+      timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+      setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+      const auto line = ReadLine(client_fd);
+      const auto query = line ? nlohmann::json::parse(*line, nullptr, false) : nlohmann::json();
+      if (!query.is_object()) {
+        WriteLine(client_fd, nlohmann::json({ { "error", "Invalid query" } }).dump());
+        close(client_fd);
+      } else if (query.value("query", "") == "shutdown") {
+        WriteLine(client_fd, nlohmann::json({ { "result", "ok" } }).dump());
+        close(client_fd);
+        stop_requested = 1;
+      } else {
+        state.Answer(client_fd, query);
+      }
+    }
+
+    state.DispatchQuery();
+  }
+
+  spdlog::info("Shutting down");
+  state.StopWorker();
+  close(listen_fd);
+  close(state.inotify_fd);
+  close(state.worker_event_fd);
+  fs::remove(GetDaemonSocketPath());
+
+  return true;
+#else
+  spdlog::error("The daemon relies on inotify and is only supported on Linux");
+  return false;
+#endif
+}
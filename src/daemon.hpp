@@ -0,0 +1,24 @@
+#pragma once
+
+#include <optional>
+
+#include "nlohmann/json.hpp"
+#include "utils.hpp"
+
+// Queries are json objects of the form { "query": ..., "cwd": ..., "argument": ... }.
+// Answers either contain a "result" or an "error" member.
+
+// Returns the path of the unix domain socket the daemon listens on.
+Path GetDaemonSocketPath();
+
+// Answers the query in the current process.
+nlohmann::json AnswerQuery(const nlohmann::json& query);
+
+// Sends the query to the daemon. Returns std::nullopt if no daemon is running.
+std::optional<nlohmann::json> QueryDaemon(const nlohmann::json& query);
+
+// Answers the query using the daemon if it is running, otherwise in the current process.
+nlohmann::json Query(const nlohmann::json& query);
+
+// Serves queries until the daemon is stopped.
+bool RunDaemon();
@@ -0,0 +1,564 @@
+#include "include_analysis.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <shared_mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+
+#include "cmake.hpp"
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+constexpr unsigned kMinUnityBuildTranslationUnits = 4;
+constexpr double kMinUnityBuildRedundancy = 3.0;
+// Share of the translation units of a target that must include a header to make it a precompiled header candidate.
+constexpr double kMinPrecompiledHeaderShare = 0.5;
+constexpr std::uintmax_t kMinPrecompiledHeaderClosureSize = 32 * 1024;
+constexpr size_t kMaxPrecompiledHeaderCandidates = 5;
+
+struct IncludeDirective {
+  std::string name;
+  bool quoted;
+};
+
+struct File {
+  std::string path;
+  uint32_t id;
+
+  std::once_flag scan_flag;
+  std::uintmax_t size = 0;
+  std::vector<IncludeDirective> includes;
+
+  // The files included by this file using the include directories of any translation unit.
+  std::mutex included_files_mutex;
+  std::vector<File*> included_files;
+
+  // Number of translation units including this file, summed up from the targets.
+  unsigned included_by = 0;
+};
+
+// Files are never removed, so pointers to them stay valid while other threads add files.
+struct FileTable {
+  std::mutex mutex;
+  std::unordered_map<std::string, File*> files_by_path;
+  std::deque<File> files;
+
+  std::shared_mutex existence_mutex;
+  std::unordered_map<std::string, bool> existence;
+
+  File* Get(const std::string& path) {
+    std::lock_guard lock(mutex);
+    auto [entry, inserted] = files_by_path.try_emplace(path, nullptr);
+    if (inserted) {
+      auto& file = files.emplace_back();
+      file.path = path;
+      file.id = files.size() - 1;
+      entry->second = &file;
+    }
+    return entry->second;
+  }
+
+  bool Exists(const std::string& path) {
+    {
+      std::shared_lock lock(existence_mutex);
+      if (const auto entry = existence.find(path); entry != existence.end()) {
+        return entry->second;
+      }
+    }
+    std::error_code error;
+    const bool exists = fs::is_regular_file(path, error);
+    std::unique_lock lock(existence_mutex);
+    existence[path] = exists;
+    return exists;
+  }
+};
+
+// Translation units compiled with the same include directories share an include context.
+struct IncludeContext {
+  uint32_t id;
+  std::vector<std::string> quote_directories;
+  std::vector<std::string> directories;
+
+  // The files included by each file (indexed by File::id) resolved with the
+  // include directories of this context. Only the files reached from the
+  // translation units of the context are stored, so memory grows with the
+  // number of files each context uses rather than with all files.
+  std::shared_mutex mutex;
+  std::unordered_map<uint32_t, std::vector<File*>> included_files;
+};
+
+// State a worker thread keeps across the indices it processes.
+struct WorkerState {
+  std::vector<uint32_t> visited;
+  // The included files this thread looked up, keyed by the ids of the context
+  // and the file. The shared map of a context is only locked the first time a
+  // thread reaches a file rather than on every visit.
+  std::unordered_map<uint64_t, std::span<File* const>> included_files;
+};
+
+struct TranslationUnit {
+  std::string path;
+  std::string target;
+  IncludeContext* context;
+  std::vector<std::string> forced_includes;
+};
+
+struct TargetStatistics {
+  std::mutex mutex;
+  unsigned translation_units = 0;
+  std::uintmax_t bytes_read = 0;
+  std::uintmax_t translation_unit_bytes = 0;
+  // Number of translation units including each file, indexed by File::id.
+  std::vector<unsigned> header_counts;
+};
+
+// Scans for #include directives line by line, skipping the ones in comments.
+std::vector<IncludeDirective> ScanIncludes(std::string_view content) {
+  std::vector<IncludeDirective> includes;
+
+  const auto skip_whitespace = [](std::string_view line, size_t position) {
+    while (position < line.length() && (line[position] == ' ' || line[position] == '\t')) {
+      ++position;
+    }
+    return position;
+  };
+
+  bool in_block_comment = false;
+  for (size_t line_begin = 0; line_begin < content.length();) {
+    auto line_end = content.find('\n', line_begin);
+    if (line_end == std::string_view::npos) {
+      line_end = content.length();
+    }
+    const auto line = content.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+
+    size_t position = 0;
+    if (in_block_comment) {
+      const auto comment_end = line.find("*/");
+      if (comment_end == std::string_view::npos) {
+        continue;
+      }
+      in_block_comment = false;
+      position = comment_end + 2;
+    }
+
+    position = skip_whitespace(line, position);
+    if (position < line.length() && line[position] == '#') {
+      position = skip_whitespace(line, position + 1);
+      if (line.substr(position).starts_with("include")) {
+        position = skip_whitespace(line, position + 7);
+        if (position < line.length() && (line[position] == '"' || line[position] == '<')) {
+          const bool quoted = line[position] == '"';
+          const auto name_end = line.find(quoted ? '"' : '>', position + 1);
+          if (name_end != std::string_view::npos) {
+            includes.push_back({
+              .name = std::string(line.substr(position + 1, name_end - position - 1)),
+              .quoted = quoted,
+            });
+          }
+        }
+      }
+    }
+
+    for (; position + 1 < line.length(); ++position) {
+      if (in_block_comment) {
+        if (line[position] == '*' && line[position + 1] == '/') {
+          in_block_comment = false;
+          ++position;
+        }
+      } else if (line[position] == '/' && line[position + 1] == '/') {
+        break;
+      } else if (line[position] == '/' && line[position + 1] == '*') {
+        in_block_comment = true;
+        ++position;
+      }
+    }
+  }
+
+  return includes;
+}
+
+void ScanFile(File* file) {
+  std::call_once(file->scan_flag, [file]() {
+    if (const auto content = ReadFile(file->path); content) {
+      file->size = content->length();
+      file->includes = ScanIncludes(*content);
+    }
+  });
+}
+
+const std::vector<File*>& ResolveIncludedFiles(FileTable& file_table, IncludeContext& context, File* file) {
+  {
+    std::shared_lock lock(context.mutex);
+    if (const auto entry = context.included_files.find(file->id); entry != context.included_files.end()) {
+      return entry->second;
+    }
+  }
+
+  ScanFile(file);
+
+  const auto includer_directory = Path(file->path).parent_path().string();
+  std::vector<File*> included_files;
+  for (const auto& include : file->includes) {
+    const auto try_directories = [&](const std::vector<std::string>& directories) {
+      for (const auto& directory : directories) {
+        const auto include_path = (Path(directory) / include.name).lexically_normal().string();
+        if (file_table.Exists(include_path)) {
+          included_files.push_back(file_table.Get(include_path));
+          return true;
+        }
+      }
+      return false;
+    };
+
+    if (include.quoted && (try_directories({ includer_directory }) || try_directories(context.quote_directories))) {
+      continue;
+    }
+    // Includes that cannot be found (e.g. platform specific ones) are ignored.
+    try_directories(context.directories);
+  }
+
+  {
+    std::lock_guard lock(file->included_files_mutex);
+    for (const auto included_file : included_files) {
+      if (std::find(file->included_files.begin(), file->included_files.end(), included_file) == file->included_files.end()) {
+        file->included_files.push_back(included_file);
+      }
+    }
+  }
+
+  // Another thread may have resolved the includes in the meantime, its result
+  // is identical. References to the entries stay valid when the map rehashes.
+  std::unique_lock lock(context.mutex);
+  return context.included_files.try_emplace(file->id, std::move(included_files)).first->second;
+}
+
+std::span<File* const> GetIncludedFiles(FileTable& file_table, IncludeContext& context, File* file, WorkerState& worker) {
+  const auto key = static_cast<uint64_t>(context.id) << 32 | file->id;
+  auto [entry, inserted] = worker.included_files.try_emplace(key);
+  if (inserted) {
+    entry->second = ResolveIncludedFiles(file_table, context, file);
+  }
+  return entry->second;
+}
+
+std::vector<std::string> SplitCommand(std::string_view command) {
+  std::vector<std::string> arguments;
+  std::string argument;
+  bool has_argument = false;
+  char quote = '\0';
+  for (size_t i = 0; i < command.length(); ++i) {
+    const char c = command[i];
+    if (c == '\\' && i + 1 < command.length() && quote != '\'') {
+      argument += command[++i];
+      has_argument = true;
+    } else if (quote != '\0') {
+      if (c == quote) {
+        quote = '\0';
+      } else {
+        argument += c;
+      }
+    } else if (c == '"' || c == '\'') {
+      quote = c;
+      has_argument = true;
+    } else if (c == ' ' || c == '\t') {
+      if (has_argument) {
+        arguments.push_back(std::move(argument));
+        argument.clear();
+        has_argument = false;
+      }
+    } else {
+      argument += c;
+      has_argument = true;
+    }
+  }
+  if (has_argument) {
+    arguments.push_back(std::move(argument));
+  }
+  return arguments;
+}
+
+// Runs the function for every index in [0, count) on thread_count threads,
+// passing it the state of the worker thread running it.
+template <typename Function>
+void ParallelFor(size_t count, unsigned thread_count, const Function& function) {
+  std::atomic<size_t> next_index = 0;
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < std::max(thread_count, 1u); ++i) {
+    threads.emplace_back([&]() {
+      WorkerState worker;
+      for (size_t index = next_index++; index < count; index = next_index++) {
+        function(index, worker);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}
+
+std::optional<IncludeAnalysis> AnalyzeIncludes(const Project& project, const Path& build_path, unsigned thread_count) {
+  const auto start_time = std::chrono::steady_clock::now();
+
+  std::ifstream compile_commands_file(build_path / "compile_commands.json");
+  if (!compile_commands_file.is_open()) {
+    spdlog::error("Failed to open {}", (build_path / "compile_commands.json").string());
+    return std::nullopt;
+  }
+  const auto compile_commands = nlohmann::json::parse(compile_commands_file, nullptr, false);
+  if (!compile_commands.is_array()) {
+    spdlog::error("Failed to parse {}", (build_path / "compile_commands.json").string());
+    return std::nullopt;
+  }
+
+  std::vector<std::string> implicit_include_directories;
+  if (const auto compiler = GetCompilerInfo(build_path); compiler) {
+    for (const auto& directory : compiler->implicit_include_directories) {
+      implicit_include_directories.push_back(directory.string());
+    }
+  }
+
+  std::map<std::string, std::unique_ptr<IncludeContext>> contexts;
+  std::map<std::string, TargetStatistics> targets;
+  std::vector<TranslationUnit> translation_units;
+  const std::regex target_definition(R"(CMakeFiles/([^/]+)\.dir/)");
+  for (const auto& compile_command : compile_commands) {
+    const Path directory = compile_command.value("directory", build_path.string());
+    const auto arguments = compile_command.contains("arguments") ?
+      compile_command["arguments"].get<std::vector<std::string>>() :
+      SplitCommand(compile_command.value("command", ""));
+    const auto absolute = [&](const std::string& path) {
+      return (directory / path).lexically_normal().string();
+    };
+
+    std::vector<std::string> quote_directories;
+    std::vector<std::string> include_directories;
+    std::vector<std::string> system_directories;
+    std::vector<std::string> after_directories;
+    std::vector<std::string> forced_includes;
+    std::string output = compile_command.value("output", "");
+    for (size_t i = 0; i < arguments.size(); ++i) {
+      const auto& argument = arguments[i];
+      const auto option_value = [&](std::string_view option) -> std::optional<std::string> {
+        if (argument == option) {
+          return i + 1 < arguments.size() ? std::optional(arguments[++i]) : std::nullopt;
+        } else if (argument.starts_with(option)) {
+          return argument.substr(option.length());
+        } else {
+          return std::nullopt;
+        }
+      };
+
+      if (const auto value = option_value("-iquote"); value) {
+        quote_directories.push_back(absolute(*value));
+      } else if (const auto value = option_value("-isystem"); value) {
+        system_directories.push_back(absolute(*value));
+      } else if (const auto value = option_value("-idirafter"); value) {
+        after_directories.push_back(absolute(*value));
+      } else if (const auto value = option_value("-include"); value) {
+        forced_includes.push_back(*value);
+      } else if (const auto value = option_value("-I"); value) {
+        include_directories.push_back(absolute(*value));
+      } else if (const auto value = option_value("-o"); value && output.empty()) {
+        output = *value;
+      }
+    }
+
+    // Same search order as GCC and Clang.
+    std::vector<std::string> directories = include_directories;
+    directories.insert(directories.end(), system_directories.begin(), system_directories.end());
+    directories.insert(directories.end(), implicit_include_directories.begin(), implicit_include_directories.end());
+    directories.insert(directories.end(), after_directories.begin(), after_directories.end());
+
+    std::string context_key;
+    for (const auto& quote_directory : quote_directories) {
+      context_key += quote_directory + '\n';
+    }
+    context_key += '\0';
+    for (const auto& include_directory : directories) {
+      context_key += include_directory + '\n';
+    }
+    auto& context = contexts[context_key];
+    if (!context) {
+      context = std::make_unique<IncludeContext>();
+      context->id = static_cast<uint32_t>(contexts.size() - 1);
+      context->quote_directories = std::move(quote_directories);
+      context->directories = std::move(directories);
+    }
+
+    std::smatch match;
+    const std::string target = std::regex_search(output, match, target_definition) ? match[1].str() : "unknown";
+    targets.try_emplace(target);
+
+    std::vector<std::string> forced_include_paths;
+    for (const auto& forced_include : forced_includes) {
+      forced_include_paths.push_back(absolute(forced_include));
+    }
+
+    translation_units.push_back({
+      .path = absolute(compile_command.value("file", "")),
+      .target = target,
+      .context = context.get(),
+      .forced_includes = std::move(forced_include_paths),
+    });
+  }
+
+  FileTable file_table;
+  ParallelFor(translation_units.size(), thread_count, [&](size_t index, WorkerState& worker) {
+    auto& visited = worker.visited;
+    const auto& translation_unit = translation_units[index];
+    // Stamps are unique per translation unit so visited never needs to be cleared.
+    const auto stamp = static_cast<uint32_t>(index + 1);
+
+    const auto translation_unit_file = file_table.Get(translation_unit.path);
+    std::vector<File*> pending_files = { translation_unit_file };
+    for (const auto& forced_include : translation_unit.forced_includes) {
+      if (file_table.Exists(forced_include)) {
+        pending_files.push_back(file_table.Get(forced_include));
+      }
+    }
+
+    std::vector<File*> headers;
+    std::uintmax_t bytes_read = 0;
+    while (!pending_files.empty()) {
+      const auto file = pending_files.back();
+      pending_files.pop_back();
+      if (file->id >= visited.size()) {
+        visited.resize(file->id * 2 + 1, 0);
+      }
+      if (visited[file->id] == stamp) {
+        continue;
+      }
+      visited[file->id] = stamp;
+
+      const auto included_files = GetIncludedFiles(file_table, *translation_unit.context, file, worker);
+      bytes_read += file->size;
+      if (file != translation_unit_file) {
+        headers.push_back(file);
+      }
+      pending_files.insert(pending_files.end(), included_files.begin(), included_files.end());
+    }
+
+    auto& target = targets.at(translation_unit.target);
+    std::lock_guard lock(target.mutex);
+    ++target.translation_units;
+    target.bytes_read += bytes_read;
+    target.translation_unit_bytes += translation_unit_file->size;
+    for (const auto header : headers) {
+      if (header->id >= target.header_counts.size()) {
+        target.header_counts.resize(header->id * 2 + 1, 0);
+      }
+      ++target.header_counts[header->id];
+    }
+  });
+
+  // The counts were grown on demand and may be longer or shorter than the file table.
+  for (auto& [_, statistics] : targets) {
+    statistics.header_counts.resize(file_table.files.size(), 0);
+    for (uint32_t id = 0; id < statistics.header_counts.size(); ++id) {
+      file_table.files[id].included_by += statistics.header_counts[id];
+    }
+  }
+
+  // The size of everything a header pulls in is computed on the include graph
+  // of all translation units.
+  std::vector<std::uintmax_t> closure_sizes(file_table.files.size(), 0);
+  ParallelFor(file_table.files.size(), thread_count, [&](size_t index, WorkerState& worker) {
+    if (file_table.files[index].included_by == 0) {
+      return;
+    }
+    auto& visited = worker.visited;
+    visited.resize(file_table.files.size(), 0);
+    const auto stamp = static_cast<uint32_t>(index + 1);
+
+    std::vector<File*> pending_files = { &file_table.files[index] };
+    std::uintmax_t closure_size = 0;
+    while (!pending_files.empty()) {
+      const auto file = pending_files.back();
+      pending_files.pop_back();
+      if (visited[file->id] == stamp) {
+        continue;
+      }
+      visited[file->id] = stamp;
+      closure_size += file->size;
+      pending_files.insert(pending_files.end(), file->included_files.begin(), file->included_files.end());
+    }
+    closure_sizes[index] = closure_size;
+  });
+
+  IncludeAnalysis analysis;
+  analysis.translation_units = translation_units.size();
+
+  for (auto& file : file_table.files) {
+    if (file.included_by > 0) {
+      analysis.headers.push_back({
+        .path = file.path,
+        .size = file.size,
+        .closure_size = closure_sizes[file.id],
+        .included_by = file.included_by,
+        .cost = static_cast<double>(file.included_by) * closure_sizes[file.id],
+      });
+    }
+  }
+  std::sort(analysis.headers.begin(), analysis.headers.end(), [](const auto& lhs, const auto& rhs) { return lhs.cost > rhs.cost; });
+
+  // Headers of the project itself change too often to be precompiled.
+  const auto project_path = project.path.lexically_normal().string() + '/';
+  const auto project_build_path = project.GetBuildPath().lexically_normal().string() + '/';
+  const auto is_external = [&](const std::string& path) {
+    return !path.starts_with(project_path) || path.starts_with(project_build_path);
+  };
+
+  for (auto& [name, statistics] : targets) {
+    std::uintmax_t distinct_bytes = statistics.translation_unit_bytes;
+    std::vector<std::pair<File*, double>> precompiled_header_candidates;
+    for (uint32_t id = 0; id < statistics.header_counts.size(); ++id) {
+      const auto count = statistics.header_counts[id];
+      if (count == 0) {
+        continue;
+      }
+      const auto header = &file_table.files[id];
+      distinct_bytes += header->size;
+      if (count >= kMinPrecompiledHeaderShare * statistics.translation_units &&
+          closure_sizes[header->id] >= kMinPrecompiledHeaderClosureSize &&
+          is_external(header->path)) {
+        precompiled_header_candidates.push_back({ header, static_cast<double>(count) * closure_sizes[header->id] });
+      }
+    }
+    std::sort(
+      precompiled_header_candidates.begin(),
+      precompiled_header_candidates.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; }
+    );
+
+    const auto redundancy = distinct_bytes > 0 ? static_cast<double>(statistics.bytes_read) / distinct_bytes : 0.0;
+    TargetIncludeAnalysis target = {
+      .name = name,
+      .translation_units = statistics.translation_units,
+      .redundancy = redundancy,
+      .unity_build_candidate = statistics.translation_units >= kMinUnityBuildTranslationUnits && redundancy >= kMinUnityBuildRedundancy,
+      .precompiled_header_candidates = {},
+    };
+    for (size_t i = 0; i < std::min(precompiled_header_candidates.size(), kMaxPrecompiledHeaderCandidates); ++i) {
+      target.precompiled_header_candidates.push_back(precompiled_header_candidates[i].first->path);
+    }
+    analysis.targets.push_back(std::move(target));
+  }
+
+  analysis.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  return analysis;
+}
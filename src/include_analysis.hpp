@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "project.hpp"
+
+struct HeaderCost {
+  std::string path;
+  std::uintmax_t size;
+  // Size of the header and all headers it includes transitively.
+  std::uintmax_t closure_size;
+  // Number of translation units that include the header (directly or indirectly).
+  unsigned included_by;
+  // included_by * closure_size, i.e., the amount of code the compiler reads because of this header.
+  double cost;
+};
+
+struct TargetIncludeAnalysis {
+  std::string name;
+  unsigned translation_units;
+  // Bytes read when compiling all translation units of the target divided by
+  // the size of all distinct files they include.
+  double redundancy;
+  bool unity_build_candidate;
+  // External headers included by most translation units of the target.
+  std::vector<std::string> precompiled_header_candidates;
+};
+
+struct IncludeAnalysis {
+  unsigned translation_units = 0;
+  double seconds = 0.0;
+  // Sorted by cost, most expensive first.
+  std::vector<HeaderCost> headers;
+  std::vector<TargetIncludeAnalysis> targets;
+};
+
+// Analyzes the includes of all translation units in the compile_commands.json
+// of the build directory. Includes are found by scanning for #include
+// directives without evaluating the preprocessor, so conditional includes are
+// always counted.
+std::optional<IncludeAnalysis> AnalyzeIncludes(const Project& project, const Path& build_path, unsigned thread_count);
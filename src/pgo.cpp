@@ -0,0 +1,268 @@
+#include "pgo.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "cmake.hpp"
+#include "nlohmann/json.hpp"
+#include "spdlog/fmt/bundled/format.h"
+#include "spdlog/spdlog.h"
+#include "subprocess.hpp"
+
+namespace {
+
+// Fraction of changed source files after which the profile is recorded again.
+constexpr double kDefaultMaxSourceDrift = 0.1;
+
+const std::set<std::string> kSourceExtensions = {
+  ".c", ".cc", ".cpp", ".cxx", ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp",
+};
+
+// Maps the path (relative to the project) of each source file to a hash of its content.
+std::map<std::string, std::string> HashSources(const Project& project) {
+  std::map<std::string, std::string> hashes;
+
+  const auto build_path = project.GetBuildPath();
+  for (auto entry = fs::recursive_directory_iterator(project.path); entry != fs::recursive_directory_iterator(); ++entry) {
+    if (entry->is_directory() && (entry->path() == build_path || entry->path().filename().string().starts_with('.'))) {
+      entry.disable_recursion_pending();
+      continue;
+    }
+    if (!entry->is_regular_file() || !kSourceExtensions.contains(entry->path().extension().string())) {
+      continue;
+    }
+    if (const auto content = ReadFile(entry->path()); content) {
+      hashes[fs::relative(entry->path(), project.path).string()] = fmt::format("{:016x}", HashContent(*content));
+    }
+  }
+
+  return hashes;
+}
+
+// Returns the fraction of source files that were added, removed or changed.
+double GetSourceDrift(const std::map<std::string, std::string>& recorded, const std::map<std::string, std::string>& current) {
+  std::set<std::string> files;
+  size_t changed_files = 0;
+  for (const auto& [file, hash] : recorded) {
+    files.insert(file);
+    if (const auto current_hash = current.find(file); current_hash == current.end() || current_hash->second != hash) {
+      ++changed_files;
+    }
+  }
+  for (const auto& [file, _] : current) {
+    if (files.insert(file).second) {
+      ++changed_files;
+    }
+  }
+
+  return files.empty() ? 0.0 : static_cast<double>(changed_files) / files.size();
+}
+
+std::string GetCXXFlags(const std::vector<std::string>& flags) {
+  std::string cxx_flags;
+  if (const char* environment_flags = std::getenv("CXXFLAGS"); environment_flags) {
+    cxx_flags = environment_flags;
+  }
+  for (const auto& flag : flags) {
+    if (cxx_flags.length() > 0) {
+      cxx_flags += ' ';
+    }
+    cxx_flags += flag;
+  }
+  return fmt::format("-DCMAKE_CXX_FLAGS={}", cxx_flags);
+}
+
+std::vector<std::string> GetLLVMProfdataCommand(const CompilerInfo& compiler) {
+  if (compiler.id == "AppleClang") {
+    return { "xcrun", "llvm-profdata" };
+  }
+  // Prefer the llvm-profdata shipped with the compiler as the profile format
+  // changes between LLVM versions.
+  if (const auto llvm_profdata_path = compiler.path.parent_path() / "llvm-profdata"; fs::exists(llvm_profdata_path)) {
+    return { llvm_profdata_path.string() };
+  }
+  return { "llvm-profdata" };
+}
+
+bool MergeClangProfiles(const CompilerInfo& compiler, const Path& profile_path) {
+  auto merge_command = GetLLVMProfdataCommand(compiler);
+  merge_command.push_back("merge");
+  merge_command.push_back(fmt::format("-output={}", (profile_path / "merged.profdata").string()));
+
+  bool has_raw_profiles = false;
+  for (const auto& entry : fs::directory_iterator(profile_path)) {
+    if (entry.path().extension() == ".profraw") {
+      merge_command.push_back(entry.path().string());
+      has_raw_profiles = true;
+    }
+  }
+  if (!has_raw_profiles) {
+    spdlog::error("The training command did not produce any profiles in {}", profile_path.string());
+    return false;
+  }
+
+  if (subprocess::Popen(merge_command).wait() != 0) {
+    spdlog::error("Failed to merge profiles");
+    return false;
+  }
+
+  return true;
+}
+
+// Returns the major version of a compiler version like 13.2.0.
+std::optional<unsigned> GetMajorVersion(std::string_view version) {
+  unsigned major_version;
+  const auto [end, error] = std::from_chars(version.data(), version.data() + version.size(), major_version);
+  if (error != std::errc() || end == version.data()) {
+    return std::nullopt;
+  }
+  return major_version;
+}
+
+bool HasGCCProfiles(const Path& profile_path) {
+  for (const auto& entry : fs::recursive_directory_iterator(profile_path)) {
+    if (entry.path().extension() == ".gcda") {
+      return true;
+    }
+  }
+  spdlog::error("The training command did not produce any profiles in {}", profile_path.string());
+  return false;
+}
+
+}
+
+bool BuildWithPGO(const Project& project, bool retrain) {
+  const auto config = project.ReadConfig();
+  if (!config) {
+    return false;
+  }
+
+  const auto training_command = (*config)["pgo"]["training_command"].value<std::string>();
+  if (!training_command) {
+    spdlog::error("No training command configured, set pgo.training_command in {}", (project.path / "cpm.toml").string());
+    return false;
+  }
+  const auto max_source_drift = (*config)["pgo"]["max_source_drift"].value_or(kDefaultMaxSourceDrift);
+
+  const auto instrumented_build_path = project.GetBuildPath("pgo-instrumented");
+  const auto optimized_build_path = project.GetBuildPath("pgo");
+  const auto profile_path = project.GetBuildPath("pgo-profile");
+  const auto manifest_path = profile_path / "sources.json";
+
+  if (!EnsureConfigured(project.path, instrumented_build_path, { "-DCMAKE_BUILD_TYPE=Release" })) {
+    return false;
+  }
+  const auto compiler = GetCompilerInfo(instrumented_build_path);
+  if (!compiler) {
+    spdlog::error("Failed to determine the compiler used in {}", instrumented_build_path.string());
+    return false;
+  }
+
+  std::vector<std::string> generate_flags;
+  std::vector<std::string> use_flags;
+  if (compiler->id == "GNU") {
+    const auto major_version = GetMajorVersion(compiler->version);
+    if (!major_version) {
+      spdlog::error("Failed to determine the version of GCC from \"{}\"", compiler->version);
+      return false;
+    }
+    if (*major_version < 11) {
+      spdlog::error("Profile-guided optimization requires GCC 11 or newer");
+      return false;
+    }
+    // GCC names the profiles after the object files, so the build directory
+    // prefix is stripped to match the profiles of the instrumented build in
+    // the optimized build.
+    generate_flags = {
+      fmt::format("-fprofile-generate={}", profile_path.string()),
+      fmt::format("-fprofile-prefix-path={}", instrumented_build_path.string()),
+      "-fprofile-update=atomic",
+    };
+    use_flags = {
+      fmt::format("-fprofile-use={}", profile_path.string()),
+      fmt::format("-fprofile-prefix-path={}", optimized_build_path.string()),
+      "-fprofile-partial-training",
+      "-Wno-missing-profile",
+      // Functions changed since the profile was recorded are optimized without
+      // it instead of failing the build, as in Clang.
+      "-Wno-coverage-mismatch",
+    };
+  } else if (compiler->id == "Clang" || compiler->id == "AppleClang") {
+    generate_flags = {
+      fmt::format("-fprofile-generate={}", profile_path.string()),
+    };
+    use_flags = {
+      fmt::format("-fprofile-use={}", (profile_path / "merged.profdata").string()),
+      "-Wno-profile-instr-unprofiled",
+      "-Wno-profile-instr-out-of-date",
+    };
+  } else {
+    spdlog::error("Profile-guided optimization is not supported for {}", compiler->id);
+    return false;
+  }
+
+  const auto source_hashes = HashSources(project);
+  const auto compiler_identification = fmt::format("{} {}", compiler->id, compiler->version);
+
+  bool record_profile = true;
+  if (retrain) {
+    spdlog::info("Recording new profile");
+  } else if (std::ifstream manifest_file(manifest_path); manifest_file.is_open()) {
+    const auto manifest = nlohmann::json::parse(manifest_file, nullptr, false);
+    if (manifest.is_discarded() || manifest.value("compiler", "") != compiler_identification) {
+      spdlog::info("Profile has been recorded with a different compiler");
+    } else {
+      const auto drift = GetSourceDrift(manifest.at("sources").get<std::map<std::string, std::string>>(), source_hashes);
+      if (drift > max_source_drift) {
+        spdlog::info("{:.0f}% of the sources changed since the profile has been recorded", drift * 100.0);
+      } else {
+        spdlog::info("Reusing profile ({:.0f}% of the sources changed)", drift * 100.0);
+        record_profile = false;
+      }
+    }
+  }
+
+  if (record_profile) {
+    fs::remove_all(profile_path);
+    if (!fs::create_directories(profile_path)) {
+      spdlog::error("Failed to create directory {}", profile_path.string());
+      return false;
+    }
+
+    spdlog::info("Building instrumented project");
+    if (!Configure(project.path, instrumented_build_path, { "-DCMAKE_BUILD_TYPE=Release", GetCXXFlags(generate_flags) }) ||
+        !BuildTargets(instrumented_build_path)) {
+      return false;
+    }
+
+    spdlog::info("Running training command: {}", *training_command);
+    if (subprocess::Popen({ "sh", "-c", training_command->c_str() }, subprocess::cwd{ instrumented_build_path.string().c_str() }).wait() != 0) {
+      spdlog::error("Training command failed");
+      return false;
+    }
+
+    if (compiler->id == "GNU" ? !HasGCCProfiles(profile_path) : !MergeClangProfiles(*compiler, profile_path)) {
+      return false;
+    }
+
+    const nlohmann::json manifest = {
+      { "compiler", compiler_identification },
+      { "sources", source_hashes },
+    };
+    if (!WriteFile(manifest_path, manifest.dump(2))) {
+      spdlog::warn("Failed to write {}, the profile will not be reused", manifest_path.string());
+    }
+  }
+
+  spdlog::info("Building optimized project");
+  return
+    Configure(
+      project.path,
+      optimized_build_path,
+      { "-DCMAKE_BUILD_TYPE=Release", "-DCMAKE_INTERPROCEDURAL_OPTIMIZATION=ON", GetCXXFlags(use_flags) }
+    ) &&
+    BuildTargets(optimized_build_path);
+}
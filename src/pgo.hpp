@@ -0,0 +1,9 @@
+#pragma once
+
+#include "project.hpp"
+
+// Builds the project with profile-guided and link time optimization into
+// build/pgo. The profile is recorded by running the pgo.training_command of
+// the project configuration in an instrumented build (build/pgo-instrumented)
+// and reused until the sources drift too far from the ones it was recorded for.
+bool BuildWithPGO(const Project& project, bool retrain);
@@ -1,11 +1,15 @@
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <filesystem>
 #include <optional>
 #include <regex>
 
 #include "CLI/Error.hpp"
+#include "binary_cache.hpp"
+#include "cmake.hpp"
 #include "project.hpp"
-#include "registry.hpp"
+#include "repository.hpp"
 #include "spdlog/spdlog.h"
 #include "subprocess.hpp"
 #include "utils.hpp"
@@ -24,14 +28,28 @@ std::optional<std::string> ParseProjectName(std::string project_file_conent) {
   }
 }
 
-void ParsePackages(std::string_view project_file_content) {
+std::vector<std::string> ParsePackages(std::string_view project_file_content) {
+  std::vector<std::string> packages;
   std::smatch match;
   std::string remaining_content(project_file_content);
   std::regex package_definition(R"(CPMAddPackage\s*\(\s*\"(\S+)\"\s*\))");
   while (std::regex_search(remaining_content, match, package_definition)) {
-    spdlog::info("Found package {}", match[1].str());
+    packages.push_back(match[1].str());
     remaining_content = match.suffix();
   }
+  return packages;
+}
+
+std::vector<std::string> ParseSubdirectories(std::string_view list_file_content) {
+  std::vector<std::string> subdirectories;
+  std::smatch match;
+  std::string remaining_content(list_file_content);
+  std::regex subdirectory_definition(R"(add_subdirectory\s*\(\s*\"?([^\s\")]+)\"?)");
+  while (std::regex_search(remaining_content, match, subdirectory_definition)) {
+    subdirectories.push_back(match[1].str());
+    remaining_content = match.suffix();
+  }
+  return subdirectories;
 }
 
 size_t GetPackageInsertPosition(std::string_view project_file_content) {
@@ -143,7 +161,7 @@ std::shared_ptr<Project> Project::Create(const Path& project_path, std::string_v
   return project;
 }
 
-void Project::AddPackage(std::string_view package_definition) {
+void Project::InsertPackage(std::string_view cpm_definition) {
   const auto project_file_path = path / "CMakeLists.txt";
   auto project_file_content = ReadFile(project_file_path);
   if (!project_file_content ) {
@@ -151,22 +169,241 @@ void Project::AddPackage(std::string_view package_definition) {
     throw CLI::RuntimeError(-1);
   }
 
-  std::string add_package_string;
-  if (const auto repository = Repository::Parse(package_definition); repository) {
-    add_package_string = repository->GetCPMDefinitionForLatestVersion();
-  } else if (package_definition.find(':') == std::string::npos) {
-    if (const auto package = FindPackage(package_definition); package) {
-      add_package_string = package->repository.GetCPMDefinitionForLatestVersion(package->version_prefix);
+  if (cpm_definition.length() > 0) {
+    project_file_content->insert(
+      GetPackageInsertPosition(*project_file_content),
+      fmt::format("\nCPMAddPackage(\"{}\")", cpm_definition)
+    );
+    WriteFile(project_file_path, *project_file_content);
+  }
+}
+
+std::vector<Path> Project::GetListFiles() const {
+  std::vector<Path> list_files;
+  std::vector<Path> pending_directories = { path };
+  while (!pending_directories.empty()) {
+    const auto directory = pending_directories.back();
+    pending_directories.pop_back();
+
+    const auto list_file_path = directory / "CMakeLists.txt";
+    const auto list_file_content = ReadFile(list_file_path);
+    if (!list_file_content) {
+      continue;
+    }
+    list_files.push_back(list_file_path);
+
+    for (const auto& subdirectory : ParseSubdirectories(*list_file_content)) {
+      pending_directories.push_back(directory / subdirectory);
+    }
+  }
+  return list_files;
+}
+
+std::vector<Target> Project::GetTargets() const {
+  std::vector<Target> targets;
+  std::regex target_definition(R"((add_executable|add_library)\s*\(\s*([^\s)]+))");
+  for (const auto& list_file_path : GetListFiles()) {
+    const auto list_file_content = ReadFile(list_file_path);
+    if (!list_file_content) {
+      continue;
+    }
+
+    // Targets are often named after the project, e.g. add_library(${PROJECT_NAME} ...).
+    const auto project_name = ParseProjectName(*list_file_content).value_or(name);
+
+    std::smatch match;
+    std::string remaining_content(*list_file_content);
+    while (std::regex_search(remaining_content, match, target_definition)) {
+      targets.push_back({
+        .name = match[2].str() == "${PROJECT_NAME}" ? project_name : match[2].str(),
+        .type = match[1].str() == "add_executable" ? "executable" : "library",
+        .path = list_file_path.parent_path(),
+      });
+      remaining_content = match.suffix();
+    }
+  }
+  return targets;
+}
+
+std::vector<std::string> Project::GetPackages() const {
+  std::vector<std::string> packages;
+  for (const auto& list_file_path : GetListFiles()) {
+    if (const auto list_file_content = ReadFile(list_file_path); list_file_content) {
+      const auto list_file_packages = ParsePackages(*list_file_content);
+      packages.insert(packages.end(), list_file_packages.begin(), list_file_packages.end());
     }
-  } else {
-    add_package_string = package_definition;
   }
+  return packages;
+}
+
+bool Project::AddBenchmark(std::string_view benchmark_name) {
+  const auto benchmark_path = path / benchmark_name;
+  if (fs::exists(benchmark_path)) {
+    spdlog::error("{} already exists", benchmark_path.string());
+    return false;
+  }
+
+  const auto project_file_path = path / "CMakeLists.txt";
+  auto project_file_content = ReadFile(project_file_path);
+  if (!project_file_content) {
+    spdlog::error("Failed to read {}.", project_file_path.string());
+    return false;
+  }
+
+  if (project_file_content->find("google/benchmark") == std::string::npos) {
+    // Google Benchmark requires GTest for its own tests, so they are disabled
+    // which requires the long form of CPMAddPackage.
+    const Repository benchmark_repository = {
+      .type = RepositoryType::GITHUB,
+      .url = "https://github.com/google/benchmark.git",
+      .owner = "google",
+      .name = "benchmark",
+    };
+    const auto latest_version = benchmark_repository.QueryLatestVersion();
+    const auto version = latest_version ? fmt::format("{}.{}.{}", latest_version->version.major, latest_version->version.minor, latest_version->version.patch) : "1.8.3";
 
-  if (add_package_string.length() > 0) {
     project_file_content->insert(
       GetPackageInsertPosition(*project_file_content),
-      fmt::format("\nCPMAddPackage(\"{}\")", add_package_string)
+      fmt::format(
+        "\nCPMAddPackage(\n"
+        "  NAME benchmark\n"
+        "  GITHUB_REPOSITORY google/benchmark\n"
+        "  VERSION {}\n"
+        "  OPTIONS \"BENCHMARK_ENABLE_TESTING Off\"\n"
+        ")",
+        version
+      )
     );
+  }
+  project_file_content->append(fmt::format("\nadd_subdirectory({})\n", benchmark_name));
+
+  if (!fs::create_directories(benchmark_path / "src")) {
+    spdlog::error("Failed to create directory {}", (benchmark_path / "src").string());
+    return false;
+  }
+
+  const auto benchmark_list_file = fmt::format(
+    "add_executable(\n"
+    "  {0}\n"
+    "\n"
+    "  src/{0}.cpp\n"
+    ")\n"
+    "\n"
+    "target_link_libraries(\n"
+    "  {0}\n"
+    "  PRIVATE\n"
+    "    benchmark::benchmark\n"
+    ")\n",
+    benchmark_name
+  );
+  const std::string benchmark_source_file =
+    "#include <benchmark/benchmark.h>\n"
+    "\n"
+    "#include <string>\n"
+    "\n"
+    "static void BM_StringCreation(benchmark::State& state) {\n"
+    "  for (auto _ : state) {\n"
+    "    std::string empty_string;\n"
+    "    benchmark::DoNotOptimize(empty_string);\n"
+    "  }\n"
+    "}\n"
+    "BENCHMARK(BM_StringCreation);\n"
+    "\n"
+    "BENCHMARK_MAIN();\n";
+
+  return
+    WriteFile(benchmark_path / "CMakeLists.txt", benchmark_list_file) &&
+    WriteFile(benchmark_path / "src" / fmt::format("{}.cpp", benchmark_name), benchmark_source_file) &&
     WriteFile(project_file_path, *project_file_content);
+}
+
+std::optional<toml::table> Project::ReadConfig() const {
+  const auto config_file_path = path / "cpm.toml";
+  if (!fs::exists(config_file_path)) {
+    return toml::table{};
+  }
+
+  try {
+    return toml::parse_file(config_file_path.string());
+  } catch (const toml::parse_error& error) {
+    spdlog::error("Failed to parse {}: {}", config_file_path.string(), error.description());
+    return std::nullopt;
+  }
+}
+
+bool Project::Configure(const Path& build_path, const std::vector<std::string>& cmake_arguments, bool reconfigure) const {
+  if (fs::exists(build_path / "CMakeCache.txt")) {
+    if (!reconfigure) {
+      return true;
+    }
+  } else {
+    spdlog::info("Project has not been configured yet");
+  }
+
+  // The compiler that is part of the binary cache key is only known after the
+  // project has been configured once.
+  bool configured = false;
+  if (!fs::exists(build_path / "CMakeCache.txt")) {
+    if (!::Configure(path, build_path, cmake_arguments)) {
+      return false;
+    }
+    configured = true;
+  }
+
+  const auto binary_cache_arguments = GetBinaryCacheArguments(*this, build_path, cmake_arguments);
+  if (configured) {
+    // Configuring again is only needed if it changes the packages CPM uses.
+    const auto cache_variables = ReadCMakeCache(build_path);
+    const bool changed = std::any_of(binary_cache_arguments.begin(), binary_cache_arguments.end(), [&](const std::string& argument) {
+      if (argument.starts_with("-U")) {
+        return cache_variables.contains(argument.substr(2));
+      }
+      const auto separator = argument.find('=');
+      const auto value = cache_variables.find(argument.substr(2, separator - 2));
+      return value == cache_variables.end() || value->second != argument.substr(separator + 1);
+    });
+    if (!changed) {
+      return true;
+    }
+  }
+
+  auto arguments = cmake_arguments;
+  arguments.insert(arguments.end(), binary_cache_arguments.begin(), binary_cache_arguments.end());
+  return ::Configure(path, build_path, arguments);
+}
+
+Path Project::GetBuildPath(std::string_view build_type) const {
+  if (build_type.length() > 0) {
+    std::string build_directory(build_type);
+    std::transform(build_directory.begin(), build_directory.end(), build_directory.begin(), [](unsigned char c) { return std::tolower(c); });
+    return path / "build" / build_directory;
+  } else {
+    return path / "build";
+  }
+}
+
+std::optional<std::string> Project::GetRevision(std::string_view revision) const {
+  try {
+    const std::string revision_string(revision);
+    const auto output = subprocess::check_output({ "git", "rev-parse", "--verify", "--quiet", revision_string.c_str() }, subprocess::cwd{ path.c_str() });
+    std::string commit_hash(output.buf.data(), output.length);
+    while (commit_hash.length() > 0 && std::isspace(commit_hash.back())) {
+      commit_hash.pop_back();
+    }
+    if (commit_hash.empty()) {
+      return std::nullopt;
+    }
+    return commit_hash;
+  } catch (const std::exception&) {
+    return std::nullopt;
+  }
+}
+
+bool Project::HasUncommittedChanges() const {
+  try {
+    const auto output = subprocess::check_output({ "git", "status", "--porcelain", "--untracked-files=no" }, subprocess::cwd{ path.c_str() });
+    return output.length > 0;
+  } catch (const std::exception&) {
+    return false;
   }
 }
@@ -3,9 +3,18 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
+#include <toml++/toml.h>
 #include "utils.hpp"
 
+struct Target {
+  std::string name;
+  // Either "executable" or "library".
+  std::string type;
+  Path path;
+};
+
 struct Project : std::enable_shared_from_this<Project> {
   using Ptr = std::shared_ptr<Project>;
 
@@ -15,5 +24,34 @@ struct Project : std::enable_shared_from_this<Project> {
   static std::shared_ptr<Project> Open(const Path& path);
   static std::shared_ptr<Project> Create(const Path& project_path, std::string_view template_definition = "");
 
-  void AddPackage(std::string_view package_definition);
+  // Creates an executable target using Google Benchmark.
+  bool AddBenchmark(std::string_view benchmark_name);
+
+  // Adds a CPMAddPackage call for an already resolved package definition.
+  void InsertPackage(std::string_view cpm_definition);
+
+  // Returns the root CMakeLists.txt and all files reachable via add_subdirectory().
+  std::vector<Path> GetListFiles() const;
+
+  std::vector<Target> GetTargets() const;
+
+  // Returns the definitions of all packages added via CPMAddPackage.
+  std::vector<std::string> GetPackages() const;
+
+  // Returns the project configuration stored in cpm.toml, which is empty if the
+  // file does not exist.
+  std::optional<toml::table> ReadConfig() const;
+
+  // Configures the project into build_path using the binary cache for its
+  // packages. Does nothing if build_path has been configured before unless
+  // reconfigure is set.
+  bool Configure(const Path& build_path, const std::vector<std::string>& cmake_arguments = {}, bool reconfigure = false) const;
+
+  // Returns the build directory for the given build type, e.g. build/release.
+  Path GetBuildPath(std::string_view build_type = "") const;
+
+  // Returns the commit hash of the git revision.
+  std::optional<std::string> GetRevision(std::string_view revision = "HEAD") const;
+
+  bool HasUncommittedChanges() const;
 };
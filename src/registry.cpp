@@ -1,5 +1,6 @@
 #include "registry.hpp"
 
+#include <algorithm>
 #include <charconv>
 #include <regex>
 #include <fstream>
@@ -34,7 +35,9 @@ std::optional<RegisteredPackage> RegisteredPackage::Parse(const nlohmann::json&
 std::optional<RegisteredPackage> FindPackage(std::string_view package_name) {
   const std::string package_filename = fmt::format("{}.json", package_name);
 
-  g_context.SetupRegistries();
+  if (g_context.update_registries_on_use) {
+    g_context.SetupRegistries();
+  }
 
   for (const auto& [registry_name, _] : *g_context.config["registries"].as_table()) {
     const auto registry_path = g_context.paths.registries / registry_name.str();
@@ -48,3 +51,46 @@ std::optional<RegisteredPackage> FindPackage(std::string_view package_name) {
 
   return std::nullopt;
 }
+
+std::vector<std::string> SearchPackages(std::string_view search_term) {
+  if (g_context.update_registries_on_use) {
+    g_context.SetupRegistries();
+  }
+
+  std::vector<std::string> package_names;
+  for (const auto& [registry_name, _] : *g_context.config["registries"].as_table()) {
+    const auto registry_path = g_context.paths.registries / registry_name.str();
+    if (!fs::is_directory(registry_path)) {
+      continue;
+    }
+
+    for (const auto& entry : fs::directory_iterator(registry_path)) {
+      if (entry.path().extension() != ".json") {
+        continue;
+      }
+      const auto package_name = entry.path().stem().string();
+      if (package_name.find(search_term) != std::string::npos) {
+        package_names.push_back(package_name);
+      }
+    }
+  }
+
+  std::sort(package_names.begin(), package_names.end());
+  package_names.erase(std::unique(package_names.begin(), package_names.end()), package_names.end());
+
+  return package_names;
+}
+
+std::optional<std::string> ResolvePackageDefinition(std::string_view package_definition) {
+  if (const auto repository = Repository::Parse(package_definition); repository) {
+    return repository->GetCPMDefinitionForLatestVersion();
+  } else if (package_definition.find(':') == std::string::npos) {
+    if (const auto package = FindPackage(package_definition); package) {
+      return package->repository.GetCPMDefinitionForLatestVersion(package->version_prefix);
+    } else {
+      return std::nullopt;
+    }
+  } else {
+    return std::string(package_definition);
+  }
+}
@@ -13,3 +13,10 @@ struct RegisteredPackage {
 };
 
 std::optional<RegisteredPackage> FindPackage(std::string_view package_name);
+
+// Returns the names of all registered packages containing search_term.
+std::vector<std::string> SearchPackages(std::string_view search_term);
+
+// Turns a package name, repository url or CPM definition into the definition
+// that is passed to CPMAddPackage.
+std::optional<std::string> ResolvePackageDefinition(std::string_view package_definition);
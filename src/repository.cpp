@@ -1,5 +1,8 @@
 #include "repository.hpp"
 
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <regex>
 #include "cpr/cpr.h"
 #include "spdlog/fmt/bundled/format.h"
@@ -22,8 +25,49 @@ std::optional<Repository> Repository::Parse(std::string_view uri) {
   }
 }
 
+namespace {
+
+// Tags are cached per process so long running processes (i.e., the daemon) do
+// not query the same repository over and over again.
+struct CachedVersions {
+  std::chrono::steady_clock::time_point query_time;
+  std::vector<TaggedVersion> versions;
+};
+
+constexpr auto kVersionCacheLifetime = std::chrono::minutes(10);
+
+// The daemon queries versions on a worker thread while it clears the cache on its main thread.
+std::mutex version_cache_mutex;
+std::map<std::string, CachedVersions> version_cache;
+
+thread_local unsigned failed_version_queries = 0;
+
+}
+
+void ClearVersionCache() {
+  std::lock_guard lock(version_cache_mutex);
+  version_cache.clear();
+}
+
+unsigned GetFailedVersionQueryCount() {
+  return failed_version_queries;
+}
+
 std::vector<TaggedVersion> Repository::QueryVersions(std::string_view version_prefix) const {
+  const std::string cache_key = fmt::format("{}#{}", url, version_prefix);
+  const auto now = std::chrono::steady_clock::now();
+  {
+    std::lock_guard lock(version_cache_mutex);
+    if (const auto cached = version_cache.find(cache_key); cached != version_cache.end()) {
+      if (now - cached->second.query_time < kVersionCacheLifetime) {
+        return cached->second.versions;
+      }
+      version_cache.erase(cached);
+    }
+  }
+
   std::vector<TaggedVersion> versions;
+  bool query_succeeded = false;
 
   switch (type) {
     case RepositoryType::OTHER:
@@ -34,6 +78,7 @@ std::vector<TaggedVersion> Repository::QueryVersions(std::string_view version_pr
           cpr::Url{ fmt::format("https://api.github.com/repos/{}/{}/tags", owner, name) }
         );
         if (result.status_code == 200) {
+          query_succeeded = true;
           const auto tags = nlohmann::json::parse(result.text);
           for (const auto& tag : tags) {
             const std::string& tag_name = tag["name"];
@@ -56,6 +101,7 @@ std::vector<TaggedVersion> Repository::QueryVersions(std::string_view version_pr
             }
           }
         } else {
+          ++failed_version_queries;
           spdlog::error("Failed to query tags ({}): {}", result.status_code, result.text);
         }
         break;
@@ -70,6 +116,11 @@ std::vector<TaggedVersion> Repository::QueryVersions(std::string_view version_pr
 
   std::sort(versions.begin(), versions.end(), [](const auto& lhs, const auto& rhs) { return lhs.version < rhs.version; });
 
+  if (query_succeeded) {
+    std::lock_guard lock(version_cache_mutex);
+    version_cache[cache_key] = { .query_time = now, .versions = versions };
+  }
+
   return versions;
 }
 
@@ -101,3 +152,34 @@ std::string Repository::GetCPMDefinition(const std::optional<TaggedVersion>& ver
 std::string Repository::GetCPMDefinitionForLatestVersion(std::string_view version_prefix) const {
   return GetCPMDefinition(QueryLatestVersion(version_prefix));
 }
+
+std::optional<PackageReference> PackageReference::Parse(std::string_view definition) {
+  std::regex github_regex(R"(^gh:([^/\s]+)/([^@#\s]+)(?:@([^#\s]+))?(?:#(\S+))?$)");
+
+  const std::string definition_string(definition);
+  std::smatch match;
+  if (!std::regex_match(definition_string, match, github_regex)) {
+    return std::nullopt;
+  }
+
+  return PackageReference {
+    .repository = {
+      .type = RepositoryType::GITHUB,
+      .url = fmt::format("https://github.com/{}/{}.git", match[1].str(), match[2].str()),
+      .owner = match[1].str(),
+      .name = match[2].str(),
+    },
+    .version = match[3].str(),
+    .tag = match[4].str(),
+  };
+}
+
+std::optional<SemanticVersion> PackageReference::GetPinnedVersion() const {
+  if (version.length() > 0) {
+    return SemanticVersion::Parse(version);
+  } else if (tag.starts_with('v')) {
+    return SemanticVersion::Parse(tag.substr(1));
+  } else {
+    return SemanticVersion::Parse(tag);
+  }
+}
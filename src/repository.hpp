@@ -2,6 +2,7 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "version.hpp"
 
@@ -33,3 +34,22 @@ struct Repository {
   std::string GetCPMDefinitionForLatestVersion(std::string_view version_prefix = "") const;
 };
 
+// Drops all versions cached by Repository::QueryVersions.
+void ClearVersionCache();
+
+// Returns the number of version queries of the calling thread that failed,
+// e.g. because the API rate limit has been exceeded.
+unsigned GetFailedVersionQueryCount();
+
+// A package as referenced by a CPMAddPackage call, e.g. gh:fmtlib/fmt#9.1.0.
+struct PackageReference {
+  Repository repository;
+  std::string version;
+  std::string tag;
+
+  static std::optional<PackageReference> Parse(std::string_view definition);
+
+  // Returns the version the package is pinned to if it is a semantic version.
+  std::optional<SemanticVersion> GetPinnedVersion() const;
+};
+
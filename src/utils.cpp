@@ -28,5 +28,14 @@ bool WriteFile(const Path& path, std::string_view content) {
 bool AppendFile(const Path& path, std::string_view content) {
   std::ofstream file(path, std::ios::app);
   file.write(content.data(), content.size());
-  return false;
+  return file.good();
+}
+
+uint64_t HashContent(std::string_view content) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const unsigned char character : content) {
+    hash ^= character;
+    hash *= 0x100000001b3;
+  }
+  return hash;
 }
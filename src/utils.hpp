@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <optional>
+#include <string_view>
 
 namespace fs = std::filesystem;
 
@@ -10,3 +12,7 @@ using Path = fs::path;
 std::optional<std::string> ReadFile(const Path& path);
 bool WriteFile(const Path& path, std::string_view content);
 bool AppendFile(const Path& path, std::string_view content);
+
+// 64 bit FNV-1a hash of content. Unlike std::hash it is the same for every
+// build of cpm, so it can be used for names and values that are persisted.
+uint64_t HashContent(std::string_view content);
@@ -0,0 +1,9 @@
+execute_process(
+  COMMAND ${CPM} add benchmark existing_project_benchmark
+  COMMAND_ERROR_IS_FATAL ANY
+  WORKING_DIRECTORY ./existing_project
+)
+
+if(NOT EXISTS ./existing_project/existing_project_benchmark/src/existing_project_benchmark.cpp)
+  message(FATAL_ERROR "Benchmark source file has not been created")
+endif()
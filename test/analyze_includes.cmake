@@ -0,0 +1,34 @@
+# The first run configures the project, its output is not JSON.
+execute_process(
+  COMMAND ${CPM} analyze includes
+  COMMAND_ERROR_IS_FATAL ANY
+  OUTPUT_VARIABLE analysis
+  WORKING_DIRECTORY ./existing_project
+)
+if(NOT analysis MATCHES "Scanned [1-9][0-9]* translation units")
+  message(FATAL_ERROR "No translation units scanned:\n${analysis}")
+endif()
+
+execute_process(
+  COMMAND ${CPM} analyze includes --json
+  COMMAND_ERROR_IS_FATAL ANY
+  OUTPUT_VARIABLE analysis
+  WORKING_DIRECTORY ./existing_project
+)
+foreach(key translation_units seconds headers targets)
+  string(JSON type ERROR_VARIABLE error TYPE "${analysis}" ${key})
+  if(error)
+    message(FATAL_ERROR "Missing ${key}: ${error}\n${analysis}")
+  endif()
+endforeach()
+
+string(JSON target_count LENGTH "${analysis}" targets)
+if(target_count EQUAL 0)
+  message(FATAL_ERROR "No targets analyzed:\n${analysis}")
+endif()
+foreach(key name translation_units redundancy unity_build_candidate precompiled_header_candidates)
+  string(JSON type ERROR_VARIABLE error TYPE "${analysis}" targets 0 ${key})
+  if(error)
+    message(FATAL_ERROR "Missing ${key} of target: ${error}\n${analysis}")
+  endif()
+endforeach()
@@ -0,0 +1,27 @@
+# Uses a home directory of its own so the cache of the user is never touched.
+set(home ${CMAKE_CURRENT_BINARY_DIR}/cache_home)
+set(binary_cache ${home}/.cache/cpm-cli/binary_cache)
+file(WRITE ${binary_cache}/statistics.json [=[{ "hits": 3, "misses": 1 }]=])
+file(WRITE ${binary_cache}/fmt-0000000000000001/cpm-cache-key.json "{}")
+file(WRITE ${binary_cache}/fmt-0000000000000002/cpm-cache-key.json "{}")
+file(WRITE ${binary_cache}/fmt-0000000000000002/cpm-build-failed "")
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E env HOME=${home} ${CPM} cache
+  COMMAND_ERROR_IS_FATAL ANY
+  OUTPUT_VARIABLE statistics
+)
+foreach(line "Location: ${binary_cache}" "Packages: 1" "Failed:   1" "Size:" "Hit rate: 75.0% (3 hits, 1 misses)")
+  string(FIND "${statistics}" "${line}" position)
+  if(position EQUAL -1)
+    message(FATAL_ERROR "Missing \"${line}\":\n${statistics}")
+  endif()
+endforeach()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E env HOME=${home} ${CPM} cache --clear
+  COMMAND_ERROR_IS_FATAL ANY
+)
+if(EXISTS ${binary_cache})
+  message(FATAL_ERROR "The cache has not been cleared")
+endif()
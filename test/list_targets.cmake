@@ -0,0 +1,14 @@
+execute_process(
+  COMMAND ${CPM} targets
+  COMMAND_ERROR_IS_FATAL ANY
+  OUTPUT_VARIABLE targets
+  WORKING_DIRECTORY ./existing_project
+)
+
+# The library of the template is named after its project.
+file(READ ./existing_project/CMakeLists.txt list_file)
+string(REGEX MATCH "project\\(([^ )]+)" _ "${list_file}")
+set(project_name ${CMAKE_MATCH_1})
+if(NOT targets MATCHES "${project_name} \\(library\\)")
+  message(FATAL_ERROR "Library ${project_name} of the template is not listed:\n${targets}")
+endif()
@@ -0,0 +1,48 @@
+# A project of its own, the template does not register any tests.
+file(WRITE ./test_runner_project/CMakeLists.txt [=[
+cmake_minimum_required(VERSION 3.21)
+project(TestRunner LANGUAGES NONE)
+enable_testing()
+add_test(NAME passing COMMAND ${CMAKE_COMMAND} -E true)
+add_test(NAME failing COMMAND ${CMAKE_COMMAND} -E false)
+]=])
+
+execute_process(
+  COMMAND ${CPM} test
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE output
+  WORKING_DIRECTORY ./test_runner_project
+)
+if(result EQUAL 0)
+  message(FATAL_ERROR "Failing test has not been reported:\n${output}")
+endif()
+if(NOT output MATCHES "Ran 2 tests \\(1 failed\\)")
+  message(FATAL_ERROR "Unexpected summary:\n${output}")
+endif()
+
+file(READ ./test_runner_project/build/cpm-test-history.json history)
+string(JSON failed_test GET "${history}" failed_tests 0)
+string(JSON passing_runs GET "${history}" tests passing runs)
+if(NOT failed_test STREQUAL "failing" OR NOT passing_runs EQUAL 1)
+  message(FATAL_ERROR "Unexpected history:\n${history}")
+endif()
+
+execute_process(
+  COMMAND ${CPM} test --failed
+  OUTPUT_VARIABLE output
+  WORKING_DIRECTORY ./test_runner_project
+)
+if(NOT output MATCHES "Ran 1 tests \\(1 failed\\)")
+  message(FATAL_ERROR "Not only the failed test has been rerun:\n${output}")
+endif()
+
+foreach(shard 1/2 2/2)
+  execute_process(
+    COMMAND ${CPM} test --shard ${shard}
+    OUTPUT_VARIABLE output
+    WORKING_DIRECTORY ./test_runner_project
+  )
+  if(NOT output MATCHES "Ran 1 tests")
+    message(FATAL_ERROR "Shard ${shard} does not contain one test:\n${output}")
+  endif()
+endforeach()